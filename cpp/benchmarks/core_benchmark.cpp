@@ -0,0 +1,246 @@
+// nanoseconds and heap allocations per operation on the per-tick and per-packet paths, which decide how many
+// matches fit on a host - log lines go to stdout, so send that to /dev/null and read the results from stderr
+//
+// usage: core_benchmark [milliseconds per case] > /dev/null
+
+#include "server.h"
+#include "simulation.h"
+#include "tools/common.h"
+#include "tools/logger.h"
+
+#include <chrono>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace multi_pong;
+
+// allocations are counted per thread so the log writer's own do not show up against the calling thread
+static thread_local uint64_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    allocations++;
+    if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    allocations++;
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+
+// keeps a result alive so the work that produced it is not optimised away
+template<typename T>
+static inline void keep(const T& value) {
+#ifdef _MSC_VER
+    volatile const void* sink = &value;
+    (void)sink;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+static std::chrono::milliseconds duration{ 300 };
+
+// runs the operation in growing batches until a batch takes the whole duration, after one batch to warm up
+template<typename Operation>
+static void measure(const char* name, Operation&& operation) {
+    using clock = std::chrono::steady_clock;
+
+    for (int i = 0; i < 1000; i++) operation();
+
+    uint64_t iterations = 1000;
+
+    while (true) {
+        uint64_t allocations_before = allocations;
+        auto start = clock::now();
+
+        for (uint64_t i = 0; i < iterations; i++) operation();
+
+        auto elapsed = clock::now() - start;
+
+        if (elapsed >= duration || iterations >= (uint64_t(1) << 34)) {
+            double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+            std::fprintf(stderr, "%-44s %12.1f %12.2f\n", name, nanoseconds / iterations, static_cast<double>(allocations - allocations_before) / iterations);
+            return;
+        }
+
+        iterations *= 2;
+    }
+}
+
+static State make_state(const Tokens& tokens) {
+    State state;
+    state.set_token(tokens.token_1());
+    state.set_frame(123456);
+    state.mutable_ball()->set_x(0.4f);
+    state.mutable_ball()->set_y(0.6f);
+
+    Player* player_1 = state.mutable_player_1();
+    player_1->set_identifier(Player::PLAYER_1);
+    player_1->set_paddle_location(0.3f);
+    player_1->set_paddle_direction(Direction::UP);
+    player_1->set_score(3);
+    player_1->set_sequence(4321);
+    player_1->set_sequence_frame(123400);
+
+    Player* player_2 = state.mutable_player_2();
+    player_2->CopyFrom(*player_1);
+    player_2->set_identifier(Player::PLAYER_2);
+    player_2->set_paddle_location(0.7f);
+    return state;
+}
+
+// the same message building as Server::send and Client::send_message_to_server, without the sendto
+template<typename T>
+static std::string serialise(const T& data) {
+    Message message;
+
+    if constexpr (std::is_same_v<T, State>) {
+        message.mutable_state()->CopyFrom(data);
+    } else {
+        message.mutable_movement()->CopyFrom(data);
+    }
+
+    std::string serialised_message;
+    message.SerializeToString(&serialised_message);
+    return serialised_message;
+}
+
+static void benchmark_protocol(const Tokens& tokens) {
+    State state = make_state(tokens);
+
+    Movement movement;
+    movement.set_token(tokens.token_1());
+    movement.set_direction(Direction::DOWN);
+    movement.set_sequence(4321);
+    for (int i = 0; i < MULTI_PONG_MOVEMENT_HISTORY; i++) {
+        movement.add_history(static_cast<uint32_t>(i * 3) << 2 | static_cast<uint32_t>(i % 3));
+    }
+
+    std::string serialised_state = serialise(state);
+    std::string serialised_movement = serialise(movement);
+
+    // both receive loops parse into one message kept across datagrams
+    Message received;
+
+    measure("State message serialise", [&] { keep(serialise(state)); });
+    measure("State message parse", [&] { keep(received.ParseFromArray(serialised_state.data(), static_cast<int>(serialised_state.size()))); });
+    measure("Movement message serialise", [&] { keep(serialise(movement)); });
+    measure("Movement message parse", [&] { keep(received.ParseFromArray(serialised_movement.data(), static_cast<int>(serialised_movement.size()))); });
+}
+
+static void benchmark_simulation(const Tokens& tokens) {
+    // ball positions sweep across the paddle so both the hit and the miss paths are taken
+    std::vector<Ball> balls(256);
+    for (size_t i = 0; i < balls.size(); i++) {
+        balls[i].set_x(MULTI_PONG_PADDLE_HORIZONTAL_PADDING + (static_cast<float>(i % 16) - 8.0f) * 0.002f);
+        balls[i].set_y(0.5f + (static_cast<float>(i / 16) - 8.0f) * 0.015f);
+    }
+
+    size_t next_ball = 0;
+    measure("Simulation::did_ball_hit_paddle", [&] {
+        float relative_hit = 0.0f;
+        keep(Simulation::did_ball_hit_paddle(balls[next_ball++ & 255], MULTI_PONG_PADDLE_HORIZONTAL_PADDING, 0.5f, relative_hit));
+        keep(relative_hit);
+    });
+
+    Simulation simulation;
+    State state = make_state(tokens);
+    Player player_1 = state.player_1();
+    Player player_2 = state.player_2();
+    player_1.set_paddle_direction(Direction::STOP);
+    player_2.set_paddle_direction(Direction::STOP);
+    simulation.reset_ball(state);
+
+    measure("game tick, simulation only", [&] {
+        simulation.step(state, player_1, player_2);
+        keep(state);
+    });
+
+    Simulation fixed_simulation(Simulation::Mode::Fixed, 1);
+    fixed_simulation.reset_ball(state);
+
+    measure("game tick, fixed point simulation only", [&] {
+        fixed_simulation.step(state, player_1, player_2);
+        keep(state);
+    });
+
+    // what Server::game_loop does each tick short of the two sendto calls
+    measure("game tick, simulation and state for 2 players", [&] {
+        simulation.step(state, player_1, player_2);
+        state.mutable_player_1()->CopyFrom(player_1);
+        state.mutable_player_2()->CopyFrom(player_2);
+
+        for (const std::string* token : { &tokens.token_1(), &tokens.token_2() }) {
+            state.set_token(*token);
+            keep(serialise(state));
+        }
+    });
+}
+
+static void benchmark_tokens(const Tokens& tokens) {
+    std::string unknown = Server::generate_random_sequence();
+
+    measure("Server::generate_random_sequence", [] { keep(Server::generate_random_sequence()); });
+    measure("Server::get_player_id_by_token, player 2", [&] { keep(Server::get_player_id_by_token(tokens, tokens.token_2())); });
+    measure("Server::get_player_id_by_token, unknown", [&] { keep(Server::get_player_id_by_token(tokens, unknown)); });
+}
+
+// the per-packet lines of the server at each level with its default settings, so debug is filtered at run
+// time or compiled out and the asynchronous ring drops records whenever the writer falls behind
+static void benchmark_logging(const Tokens& tokens) {
+    Logger::level = Logger::Level::Info;
+    int value = 0;
+
+    measure(Logger::compiled(Logger::Level::Debug) ? "LOGGER_DEBUG, filtered out" : "LOGGER_DEBUG, compiled out", [&] {
+        LOGGER_DEBUG("Player ", value++ & 1, " sent movement direction ", value, " with token ", tokens.token_1());
+    });
+    measure("LOGGER_INFO", [&] {
+        LOGGER_INFO("Player ", value++ & 1, " sent movement direction ", value, " with token ", tokens.token_1());
+    });
+    measure("LOGGER_WARNING", [&] {
+        LOGGER_WARNING("Player ", value++ & 1, " sent movement direction ", value, " with token ", tokens.token_1());
+    });
+    measure("LOGGER_ERROR", [&] {
+        LOGGER_ERROR("Player ", value++ & 1, " sent movement direction ", value, " with token ", tokens.token_1());
+    });
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        duration = std::chrono::milliseconds(std::max(1, std::atoi(argv[1])));
+    }
+
+    Tokens tokens;
+    tokens.set_token_1(Server::generate_random_sequence());
+    tokens.set_token_2(Server::generate_random_sequence());
+
+    std::fprintf(stderr, "%-44s %12s %12s\n", "operation", "ns/op", "allocs/op");
+
+    benchmark_protocol(tokens);
+    benchmark_simulation(tokens);
+    benchmark_tokens(tokens);
+    benchmark_logging(tokens);
+
+    return 0;
+}
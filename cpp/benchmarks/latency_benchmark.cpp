@@ -0,0 +1,190 @@
+// input latency over loopback with a coordinator, a server and two clients in one process - every input is
+// timestamped at each stage from the key event to the first frame showing the server's answer, see
+// tools/trace.h, and each stage is reported as percentiles in microseconds
+//
+// usage: latency_benchmark [inputs per client] [client frames per second] [coordinator port] > /dev/null
+//
+// the server listens on the port after the coordinator's
+
+#include "client.h"
+#include "server.h"
+#include "coordinator.h"
+#include "tools/common.h"
+#include "tools/logger.h"
+#include "tools/metrics.h"
+#include "tools/renderer.h"
+#include "tools/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifndef MULTI_PONG_TRACE
+#error "latency_benchmark has to be built with MULTI_PONG_TRACE"
+#endif
+
+using namespace multi_pong;
+
+static constexpr auto INPUT_INTERVAL = std::chrono::milliseconds(40);  // long enough for each input to be answered alone
+static constexpr auto SETTLE_TIME = std::chrono::milliseconds(500);  // for the last input to come back
+static constexpr auto TIMEOUT = std::chrono::seconds(30);  // to get matched and start playing
+
+// samples the state at a fixed frame rate like a real renderer, alternating up and down once playing
+class ScriptedRenderer : public Renderer {
+    private:
+        Client* client = nullptr;
+        int inputs;
+        std::chrono::steady_clock::duration frame_period;
+        std::atomic<int>& finished;
+
+    public:
+        ScriptedRenderer(int input_count, int fps, std::atomic<int>& finished_clients)
+            : inputs(input_count), frame_period(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps))),
+              finished(finished_clients) {}
+
+        bool setup(Client* c) override {
+            client = c;
+            return true;
+        }
+
+        void toggle_fullscreen() override {}
+        void update_state() override {}
+
+        // never returns, the process exits once both clients are done
+        void render_loop() override {
+            using clock = std::chrono::steady_clock;
+
+            auto next_frame = clock::now();
+            auto next_input = next_frame;
+            auto done_at = clock::time_point::max();
+            int sent = 0;
+
+            while (true) {
+                next_frame += frame_period;
+                if (next_frame < clock::now()) {
+                    next_frame = clock::now();
+                }
+                std::this_thread::sleep_until(next_frame);
+
+                const State& state = client->get_state();
+                auto now = clock::now();
+
+                if (sent < inputs && state.frame() != 0 && now >= next_input) {
+                    client->send_move(sent % 2 ? Direction::UP : Direction::DOWN);
+                    next_input = now + INPUT_INTERVAL;
+
+                    if (++sent == inputs) {
+                        done_at = now + SETTLE_TIME;
+                    }
+                }
+
+                if (now >= done_at) {
+                    done_at = clock::time_point::max();
+                    finished++;
+                }
+            }
+        }
+};
+
+struct Span {
+    const char* name;
+    trace::Stage from;
+    trace::Stage to;
+};
+
+static constexpr Span SPANS[] = {
+    { "key event -> movement sent", trace::Stage::KeyEvent, trace::Stage::MovementSent },
+    { "movement sent -> server applied", trace::Stage::MovementSent, trace::Stage::ServerApplied },
+    { "server applied -> state received", trace::Stage::ServerApplied, trace::Stage::StateReceived },
+    { "state received -> frame ready", trace::Stage::StateReceived, trace::Stage::FrameReady },
+    { "key event -> frame ready", trace::Stage::KeyEvent, trace::Stage::FrameReady },
+};
+
+static void report(int inputs) {
+    Histogram spans[std::size(SPANS)];  // nanoseconds
+    int incomplete = 0;
+
+    for (int player = 0; player < 2; player++) {
+        for (uint32_t sequence = 1; sequence <= static_cast<uint32_t>(inputs); sequence++) {
+            bool complete = true;
+            for (int stage = 0; stage < static_cast<int>(trace::Stage::Count); stage++) {
+                complete &= trace::at(player, sequence, static_cast<trace::Stage>(stage)) != 0;
+            }
+
+            if (!complete) {
+                incomplete++;
+                continue;
+            }
+
+            for (size_t i = 0; i < std::size(SPANS); i++) {
+                int64_t span = trace::at(player, sequence, SPANS[i].to) - trace::at(player, sequence, SPANS[i].from);
+                spans[i].record(static_cast<uint64_t>(std::max<int64_t>(span, 0)));
+            }
+        }
+    }
+
+    std::fprintf(stderr, "%-34s %8s %10s %10s %10s %10s\n", "stage", "inputs", "p50 us", "p90 us", "p99 us", "max us");
+
+    for (size_t i = 0; i < std::size(SPANS); i++) {
+        const Histogram& histogram = spans[i];
+        std::fprintf(stderr, "%-34s %8llu %10.1f %10.1f %10.1f %10.1f\n", SPANS[i].name, static_cast<unsigned long long>(histogram.count()),
+            histogram.percentile(50) / 1000.0, histogram.percentile(90) / 1000.0, histogram.percentile(99) / 1000.0, histogram.max() / 1000.0);
+    }
+
+    if (incomplete) {
+        std::fprintf(stderr, "%d inputs never reached every stage\n", incomplete);
+    }
+}
+
+int main(int argc, char** argv) {
+    int inputs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+    int fps = argc > 2 ? std::max(1, std::atoi(argv[2])) : 240;
+    int coordinator_port = argc > 3 ? std::atoi(argv[3]) : 14999;
+    int server_port = coordinator_port + 1;
+
+    inputs = std::min(inputs, static_cast<int>(trace::INPUTS));
+    Logger::level = Logger::Level::Warning;
+
+    std::atomic<int> finished{ 0 };
+
+    // none of these can be stopped from outside, so they run on detached threads until the process exits
+    std::thread([coordinator_port, server_port] {
+        Coordinator coordinator(coordinator_port, { { "127.0.0.1", server_port } });
+    }).detach();
+
+    std::thread([coordinator_port, server_port] {
+        Server server(server_port, { "127.0.0.1", coordinator_port });
+    }).detach();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (int i = 0; i < 2; i++) {
+        std::thread([&finished, inputs, fps, coordinator_port] {
+            Client client("127.0.0.1", coordinator_port, std::make_unique<ScriptedRenderer>(inputs, fps, finished));
+        }).detach();
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + TIMEOUT + inputs * INPUT_INTERVAL;
+
+    while (finished < 2 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    if (finished < 2) {
+        std::fprintf(stderr, "Timed out with %d of 2 clients finished\n", finished.load());
+    }
+
+    std::fprintf(stderr, "%d inputs per client at %d client frames per second\n\n", inputs, fps);
+    report(inputs);
+
+    Logger::shutdown();
+    std::fflush(stdout);
+    std::_Exit(finished == 2 ? 0 : 1);
+}
@@ -0,0 +1,157 @@
+// cost of a log call on the calling thread for each way of logging - the log lines themselves go to stdout,
+// so send that to a file or /dev/null and read the results from stderr
+//
+// usage: logger_benchmark [calls per thread] [binary log path] > /dev/null
+
+// debug records are compiled out here whatever the build type, so the ways a record can be disabled can be
+// compared side by side
+#undef MULTI_PONG_LOG_LEVEL
+#define MULTI_PONG_LOG_LEVEL 1
+
+#include "tools/common.h"
+#include "tools/logger.h"
+#include "tools/metrics.h"
+
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+static constexpr int THREAD_COUNTS[] = { 1, 4 };
+static constexpr int CALLS_PER_SAMPLE = 64;  // calls timed together so the clock does not dominate
+
+struct Mode {
+    const char* name;
+    Logger::Level level;
+    bool asynchronous;
+    Logger::Overflow overflow;
+    bool binary;  // opens the binary log, so it has to come last
+};
+
+static constexpr Mode MODES[] = {
+    { "filtered out", Logger::Level::Warning, true, Logger::Overflow::Drop, false },
+    { "synchronous", Logger::Level::Info, false, Logger::Overflow::Drop, false },
+    { "async drop", Logger::Level::Info, true, Logger::Overflow::Drop, false },
+    { "async block", Logger::Level::Info, true, Logger::Overflow::Block, false },
+    { "binary", Logger::Level::Info, true, Logger::Overflow::Drop, true },
+};
+
+// the shape of the per-packet debug lines in the server and client
+static void produce(int calls, Histogram& samples) {
+    using clock = std::chrono::steady_clock;
+
+    for (int call = 0; call < calls; call += CALLS_PER_SAMPLE) {
+        auto start = clock::now();
+
+        for (int i = 0; i < CALLS_PER_SAMPLE; i++) {
+            LOGGER_INFO("Player ", i & 1, " sent movement direction ", call + i, " at ", 0.5f, " from ", "127.0.0.1");
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        samples.record(static_cast<uint64_t>(elapsed / CALLS_PER_SAMPLE));
+    }
+}
+
+// keeps the loop and the address update from being folded away when the log call disappears
+static inline void barrier() {
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+#else
+    asm volatile("" ::: "memory");
+#endif
+}
+
+// the per-packet debug line in Server::listen, with the address formatted the same way
+template<typename Call>
+static double disabled_call(int calls, Call&& call) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < calls; i++) {
+        address.sin_port = htons(static_cast<uint16_t>(i));
+        call(address);
+        barrier();
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(elapsed) / calls;
+}
+
+static void benchmark_disabled_levels(int calls) {
+    Logger::level = Logger::Level::Warning;
+
+    std::fprintf(stderr, "\n%32s %12s\n", "disabled record", "ns/call");
+
+    std::fprintf(stderr, "%32s %12.2f\n", "no log call", disabled_call(calls, [](const sockaddr_in&) {}));
+
+    std::fprintf(stderr, "%32s %12.2f\n", "debug compiled out", disabled_call(calls, [](const sockaddr_in& address) {
+        LOGGER_DEBUG("Message from ", address_string(address), ":", ntohs(address.sin_port));
+    }));
+
+    std::fprintf(stderr, "%32s %12.2f\n", "info filtered at runtime", disabled_call(calls, [](const sockaddr_in& address) {
+        LOGGER_INFO("Message from ", address_string(address), ":", ntohs(address.sin_port));
+    }));
+
+    std::fprintf(stderr, "%32s %12.2f\n", "info filtered, eager arguments", disabled_call(calls, [](const sockaddr_in& address) {
+        Logger::info("Message from ", address_string(address), ":", ntohs(address.sin_port));
+    }));
+}
+
+int main(int argc, char** argv) {
+    int calls = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const char* binary_path = argc > 2 ? argv[2] : "logger_benchmark.bin";
+    bool binary_opened = false;
+
+    benchmark_disabled_levels(calls * 50);
+    std::fprintf(stderr, "\n");
+
+    std::fprintf(stderr, "%14s %8s %12s %12s %12s %12s\n", "mode", "threads", "mean ns", "p50 ns", "p99 ns", "max ns");
+
+    for (const Mode& mode : MODES) {
+        for (int thread_count : THREAD_COUNTS) {
+            Logger::level = mode.level;
+            Logger::asynchronous = mode.asynchronous;
+            Logger::overflow = mode.overflow;
+
+            if (mode.binary && !binary_opened) {
+                if (!Logger::open_binary(binary_path)) {
+                    std::fprintf(stderr, "Failed to open binary log %s\n", binary_path);
+                    return -1;
+                }
+
+                binary_opened = true;
+            }
+
+            std::vector<Histogram> samples(thread_count);
+            std::vector<std::thread> threads;
+
+            for (int i = 0; i < thread_count; i++) {
+                threads.emplace_back(produce, calls, std::ref(samples[i]));
+            }
+
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+
+            Histogram combined;
+            for (const Histogram& histogram : samples) {
+                combined.merge(histogram);
+            }
+
+            std::fprintf(stderr, "%14s %8d %12llu %12llu %12llu %12llu\n", mode.name, thread_count, static_cast<unsigned long long>(combined.mean()),
+                static_cast<unsigned long long>(combined.percentile(50)), static_cast<unsigned long long>(combined.percentile(99)),
+                static_cast<unsigned long long>(combined.max()));
+
+            // let the writer catch up so one mode's backlog does not slow the next
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+    }
+
+    return 0;
+}
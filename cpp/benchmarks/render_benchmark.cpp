@@ -0,0 +1,93 @@
+// frame time of the instanced quad renderer as the number of quads grows - run with LIBGL_ALWAYS_SOFTWARE=1
+// to measure a software GL implementation, where every quad costs CPU time and batching matters most
+//
+// usage: render_benchmark [frames per size]
+
+#include "tools/common.h"
+#include "tools/logger.h"
+#include "tools/metrics.h"
+#include "tools/quad_batch.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+
+static constexpr size_t QUAD_COUNTS[] = { 3, 64, 1024, 4096, 16384, 65536 };
+static constexpr int WARMUP_FRAMES = 20;
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? std::atoi(argv[1]) : 300;
+
+    if (!glfwInit()) {
+        LOGGER_ERROR("Failed to initialise GLFW");
+        return 1;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow* window = glfwCreateWindow(1280, 720, "Pong benchmark", NULL, NULL);
+
+    if (!window) {
+        glfwTerminate();
+        LOGGER_ERROR("Failed to create GLFW window");
+        return 1;
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        LOGGER_ERROR("Failed to initialise GLAD");
+        return 1;
+    }
+
+    LOGGER_INFO("Renderer: ", reinterpret_cast<const char*>(glGetString(GL_RENDERER)), " / ", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+
+    std::printf("%10s %12s %12s %12s %12s %14s\n", "quads", "draws/frame", "mean ms", "p50 ms", "p99 ms", "ns/quad");
+
+    for (size_t quad_count : QUAD_COUNTS) {
+        QuadBatch quads;
+        if (!quads.setup()) return 1;
+
+        Histogram frame_times;  // microseconds
+
+        for (int frame = -WARMUP_FRAMES; frame < frames; frame++) {
+            auto start = std::chrono::steady_clock::now();
+
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // a grid of small quads drifting with the frame so nothing can be cached between frames
+            float drift = static_cast<float>(frame % 100) * 0.001f;
+            for (size_t i = 0; i < quad_count; i++) {
+                float x = static_cast<float>(i % 256) / 256.0f + drift;
+                float y = static_cast<float>((i / 256) % 144) / 144.0f;
+                quads.add(x, y, MULTI_PONG_BALL_WIDTH / 4.0f, MULTI_PONG_BALL_HEIGHT / 4.0f);
+            }
+            quads.draw();
+
+            glfwSwapBuffers(window);
+            glFinish();
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            if (frame >= 0) frame_times.record(static_cast<uint64_t>(elapsed.count()));
+        }
+
+        quads.release();
+
+        size_t draws = (quad_count + MULTI_PONG_QUAD_BATCH_CAPACITY - 1) / MULTI_PONG_QUAD_BATCH_CAPACITY;
+        std::printf("%10zu %12zu %12.3f %12.3f %12.3f %14.1f\n", quad_count, draws,
+            frame_times.mean() / 1000.0, frame_times.percentile(50) / 1000.0, frame_times.percentile(99) / 1000.0,
+            frame_times.mean() * 1000.0 / static_cast<double>(quad_count));
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
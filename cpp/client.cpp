@@ -1,8 +1,12 @@
 #include "client.h"
 #include "tools/logger.h"
+#include "tools/trace.h"
 
 #include <thread>
 #include <string>
+#include <chrono>
+#include <vector>
+#include <algorithm>
 
 using namespace multi_pong;
 
@@ -10,19 +14,21 @@ Client::Client(const std::string& host, int port, std::unique_ptr<Renderer> game
 #ifdef _WIN32
     WSADATA wsa_data;
     if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
-        Logger::error("Failed to initialise Winsock");
+        LOGGER_ERROR("Failed to initialise Winsock");
         return;
     }
 #endif
 
-    state.mutable_ball()->set_x(0.5);
-    state.mutable_ball()->set_y(0.5);
+    render_state.mutable_ball()->set_x(0.5);
+    render_state.mutable_ball()->set_y(0.5);
+    render_state.mutable_player_1()->set_identifier(Player::PLAYER_1);
+    render_state.mutable_player_2()->set_identifier(Player::PLAYER_2);
 
     coordinator_address = { host, port };
 
     coordinator_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (coordinator_socket < 0) {
-        Logger::error("Failed to create coordinator socket");
+        LOGGER_ERROR("Failed to create coordinator socket");
         return;
     }
 
@@ -30,22 +36,24 @@ Client::Client(const std::string& host, int port, std::unique_ptr<Renderer> game
         return;
     }
 
-    std::thread listen_coordinator_thread(&Client::listen_coordinator, this);
-    listen_coordinator_thread.detach();
-
     server_socket = socket(AF_INET, SOCK_DGRAM, 0);
     if (server_socket < 0) {
-        Logger::error("Failed to create server socket");
+        LOGGER_ERROR("Failed to create server socket");
         return;
     }
 
-    Message search_message = Message();
-    search_message.mutable_search()->CopyFrom(Search());
-    send_message_to_coordinator(search_message);
-
+    // the network threads notify the renderer of new states, so it has to exist before they start
     renderer = std::move(game_renderer);
     renderer->setup(this);
 
+    std::thread listen_coordinator_thread(&Client::listen_coordinator, this);
+    listen_coordinator_thread.detach();
+
+    // the search is sent once the candidate servers have been probed
+    Message query_message = Message();
+    query_message.mutable_query()->CopyFrom(Query());
+    send_message_to_coordinator(query_message);
+
     update_loop();
 }
 
@@ -65,16 +73,16 @@ bool Client::connect_coordinator() {
     inet_pton(AF_INET, coordinator_address.first.c_str(), &coordinator_server.sin_addr);
 
     if (connect(coordinator_socket, (struct sockaddr*)&coordinator_server, sizeof(coordinator_server)) < 0) {
-        Logger::error("Failed to connect to the game coordinator at ", coordinator_address.first, ":", coordinator_address.second);
+        LOGGER_ERROR("Failed to connect to the game coordinator at ", coordinator_address.first, ":", coordinator_address.second);
         return false;
     }
     
-    Logger::info("Connected to game coordinator at ", coordinator_address.first, ":", coordinator_address.second);
+    LOGGER_INFO("Connected to game coordinator at ", coordinator_address.first, ":", coordinator_address.second);
     return true;
 }
 
 void Client::listen_coordinator() {
-    Logger::info("Listening the game coordinator...");
+    LOGGER_INFO("Listening the game coordinator...");
     while (active) {
         char buffer[MULTI_PONG_SERVER_BUFFER];
 
@@ -83,53 +91,106 @@ void Client::listen_coordinator() {
         if (!received_bytes) continue;
 
         if (received_bytes < 0) {
-            Logger::error("Lost connection to the game coordinator");
+            LOGGER_ERROR("Lost connection to the game coordinator");
             break;
         }
 
         Message message;
         if (!message.ParseFromArray(buffer, received_bytes)) {
-            Logger::warning("Failed to process data into a protobuf message: ", buffer);
+            LOGGER_WARNING("Failed to process data into a protobuf message: ", buffer);
             continue;
         }
 
         switch (message.content_case()) {
+            case Message::kServers:
+                handle_servers(message.servers());
+                break;
             case Message::kMatch:
                 handle_match(message.match());
                 break;
             default:
-                Logger::warning("Received unsupported message type: ", message.content_case());
+                LOGGER_WARNING("Received unsupported message type: ", message.content_case());
         }
     }
 }
 
 void Client::listen_server() {
-    Logger::info("Listening the game server");
+    LOGGER_INFO("Listening the game server");
     char buffer[MULTI_PONG_SERVER_BUFFER];
     sockaddr_in source_address{};
     socklen_t source_address_len = sizeof(source_address);
 
+    // the receive timeout bounds how late a retransmission can be when nothing arrives
+#ifdef _WIN32
+    DWORD timeout = MULTI_PONG_TIMER_RESOLUTION;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = MULTI_PONG_TIMER_RESOLUTION / 1000;
+    timeout.tv_usec = (MULTI_PONG_TIMER_RESOLUTION % 1000) * 1000;
+#endif
+    setsockopt(server_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    Join join = Join();
+    join.set_token(token);
+    send_message_to_server(join, true);
+
+    // parsing into the same message reuses its allocations from the previous state
+    Message received_message;
+
     while (active) {
         int received = recvfrom(server_socket, buffer, sizeof(buffer) - 1, 0, (sockaddr*)&source_address, &source_address_len);
+        auto now = std::chrono::steady_clock::now();
+
+        if (received >= 0) {
+            buffer[received] = '\0';
+
+            if (!received_message.ParseFromArray(buffer, received)) {
+                LOGGER_WARNING("Failed to process data into a protobuf message: ", buffer);
+            } else if (!received_message.has_reliable()) {
+                handle_server_message(received_message);
+            } else {
+                delivered_messages.clear();
+                if (server_channel.receive(received_message, now, delivered_messages) == ReliableChannel::Receipt::Delivered) {
+                    for (const Message& delivered : delivered_messages) {
+                        handle_server_message(delivered);
+                    }
+                }
+            }
+        }
 
-        if (received < 0) continue;
-
-        buffer[received] = '\0';
+        bool delivering = server_channel.flush(now, [this](const Message& message) {
+            std::string serialised_message = message.SerializeAsString();
+            sendto(server_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0, (struct sockaddr*)&server_address, sizeof(server_address));
+        });
 
-        Message received_message;
-        if (!received_message.ParseFromArray(buffer, received)) {
-            Logger::warning("Failed to process data into a protobuf message: ", buffer);
-            continue;
+        if (!delivering) {
+            LOGGER_WARNING("Gave up on control messages to the server after ", MULTI_PONG_RELIABLE_ATTEMPTS, " attempts");
         }
+    }
+}
 
-        switch (received_message.content_case()) {
-            case Message::kState:
-                state = received_message.state();
-                break;
-            default:
-                Logger::warning("Invalid message type ", received_message.content_case(), " from server");
-                break;
-            };
+void Client::handle_server_message(const Message& message) {
+    switch (message.content_case()) {
+        case Message::kState:
+            states_received.fetch_add(1, std::memory_order_relaxed);
+            newest_state_frame.store(std::max(newest_state_frame.load(std::memory_order_relaxed), message.state().frame()), std::memory_order_relaxed);
+            read_snapshot(message.state(), now_microseconds(), received_snapshots.write_buffer());
+            TRACE_MARK(StateReceived, identifier, received_snapshots.write_buffer().sequences[identifier]);
+            received_snapshots.publish();
+            renderer->update_state();
+            break;
+        case Message::kPong:
+            handle_pong(message.pong());
+            break;
+        case Message::kRollback:
+            handle_rollback(message.rollback());
+            break;
+        case Message::kInput:
+            handle_input(message.input());
+            break;
+        default:
+            LOGGER_WARNING("Invalid message type ", message.content_case(), " from server");
+            break;
     }
 }
 
@@ -138,49 +199,372 @@ void Client::send_message_to_coordinator(multi_pong::Message message) {
     send(coordinator_socket, serialised_message.c_str(), static_cast<int>(serialised_message.size()), 0);
 }
 
+// reliable sends belong to the network thread, which owns the channel
 template<typename T>
-void Client::send_message_to_server(const T& data) {
+void Client::send_message_to_server(const T& data, bool reliable) {
     Message message;
 
     if constexpr (std::is_same_v<T, Join>) {
         message.mutable_join()->CopyFrom(data);
     } else if constexpr (std::is_same_v<T, Movement>) {
         message.mutable_movement()->CopyFrom(data);
+    } else if constexpr (std::is_same_v<T, Ping>) {
+        message.mutable_ping()->CopyFrom(data);
+    } else if constexpr (std::is_same_v<T, Input>) {
+        message.mutable_input()->CopyFrom(data);
     } else {
         return;
     }
 
+    if (reliable) {
+        server_channel.send(message, std::chrono::steady_clock::now());
+    }
+
     std::string serialised_message;
     message.SerializeToString(&serialised_message);
     sendto(server_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0, (struct sockaddr*)&server_address, sizeof(server_address));
 }
 
-template void Client::send_message_to_server<Join>(const Join&);
-template void Client::send_message_to_server<Movement>(const Movement&);
+template void Client::send_message_to_server<Join>(const Join&, bool reliable);
+template void Client::send_message_to_server<Movement>(const Movement&, bool reliable);
+template void Client::send_message_to_server<Ping>(const Ping&, bool reliable);
+template void Client::send_message_to_server<Input>(const Input&, bool reliable);
+
+void Client::handle_servers(const Servers& servers) {
+    Search search = Search();
+    measure_latencies(servers, search);
+
+    LOGGER_INFO("Searching for a match after probing ", search.latencies_size(), "/", servers.endpoints_size(), " servers");
+
+    Message search_message = Message();
+    search_message.mutable_search()->CopyFrom(search);
+    send_message_to_coordinator(search_message);
+}
+
+// all probes are sent up front so the whole measurement takes at most one timeout
+void Client::measure_latencies(const Servers& servers, Search& search) {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<sockaddr_in> addresses(servers.endpoints_size());
+    std::vector<clock::time_point> sent_at(servers.endpoints_size());
+    std::vector<bool> answered(servers.endpoints_size(), false);
+
+    Message query_message = Message();
+    query_message.mutable_query()->CopyFrom(Query());
+    std::string serialised_message = query_message.SerializeAsString();
+
+    for (int i = 0; i < servers.endpoints_size(); i++) {
+        sockaddr_in& address = addresses[i];
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(servers.endpoints(i).port());
+        inet_pton(AF_INET, servers.endpoints(i).host().c_str(), &address.sin_addr);
+
+        sent_at[i] = clock::now();
+        sendto(server_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0, (struct sockaddr*)&address, sizeof(address));
+    }
+
+    auto deadline = clock::now() + std::chrono::milliseconds(MULTI_PONG_LATENCY_PROBE_TIMEOUT);
+    char buffer[MULTI_PONG_SERVER_BUFFER];
+
+    while (search.latencies_size() < servers.endpoints_size()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - clock::now());
+        if (remaining.count() <= 0) break;
+
+#ifdef _WIN32
+        DWORD timeout = static_cast<DWORD>(std::max<long long>(1, remaining.count() / 1000));
+#else
+        struct timeval timeout;
+        timeout.tv_sec = static_cast<long>(remaining.count() / 1000000);
+        timeout.tv_usec = static_cast<long>(remaining.count() % 1000000);
+#endif
+        setsockopt(server_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+        sockaddr_in source_address{};
+        socklen_t source_address_len = sizeof(source_address);
+        int received = recvfrom(server_socket, buffer, sizeof(buffer), 0, (sockaddr*)&source_address, &source_address_len);
+        auto received_at = clock::now();
+
+        if (received < 0) break;
+
+        for (int i = 0; i < servers.endpoints_size(); i++) {
+            if (answered[i] || addresses[i].sin_addr.s_addr != source_address.sin_addr.s_addr || addresses[i].sin_port != source_address.sin_port) {
+                continue;
+            }
+
+            answered[i] = true;
+            Latency* latency = search.add_latencies();
+            latency->mutable_endpoint()->CopyFrom(servers.endpoints(i));
+            latency->set_rtt(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(received_at - sent_at[i]).count()));
+            break;
+        }
+    }
+
+#ifdef _WIN32
+    DWORD no_timeout = 0;
+#else
+    struct timeval no_timeout = {};
+#endif
+    setsockopt(server_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&no_timeout, sizeof(no_timeout));
+}
 
 void Client::handle_match(multi_pong::Match match) {
     identifier = match.player().identifier();
     token = match.token();
 
-    Join join = Join();
-    join.set_token(token);
-
     memset(&server_address, 0, sizeof(server_address));
     server_address.sin_family = AF_INET;
     inet_pton(AF_INET, match.host().c_str(), &server_address.sin_addr);
     server_address.sin_port = htons(match.port());
-    
-    send_message_to_server(join);
+    matched = true;
 
+    // the join goes out from the network thread, which owns the reliable channel
     std::thread listen_server_thread(&Client::listen_server, this);
     listen_server_thread.detach();
 }
 
 void Client::send_move(multi_pong::Direction move) {
+    if (!matched) return;
+
+    if (rollback_session) {
+        rollback_session->set_local_direction(move);
+        return;
+    }
+
+    advance_prediction();
+
+    input_sequence++;
+    TRACE_MARK(KeyEvent, identifier, input_sequence);
+    pending_inputs.push_back({ input_sequence, predicted_tick, move });
+    predicted_direction = move;
+
+    send_movement();
+}
+
+// every movement repeats the inputs the server has not acknowledged yet, so a lost datagram is covered by
+// the next one instead of leaving the paddle in the wrong direction until another key event
+void Client::send_movement() {
+    const PendingInput& newest = pending_inputs.back();
+
     Movement movement = Movement();
     movement.set_token(token);
-    movement.set_direction(move);
+    movement.set_direction(newest.direction);
+    movement.set_sequence(newest.sequence);
+
+    for (auto it = pending_inputs.rbegin() + 1; it != pending_inputs.rend() && movement.history_size() < MULTI_PONG_MOVEMENT_HISTORY; it++) {
+        if (it->sequence <= acknowledged_sequence) break;
+        movement.add_history(static_cast<uint32_t>(std::min<uint64_t>(newest.tick - it->tick, UINT32_MAX >> 2)) << 2 | static_cast<uint32_t>(it->direction));
+    }
+
     send_message_to_server(movement);
+    TRACE_MARK(MovementSent, identifier, newest.sequence);
+    movement_sent_tick = predicted_tick;
+}
+
+void Client::advance_prediction() {
+    auto now = std::chrono::steady_clock::now();
+
+    if (predicted_tick == 0 && input_sequence == 0) {
+        prediction_start = now;
+        return;
+    }
+
+    uint64_t target_tick = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - prediction_start).count() / MULTI_PONG_SERVER_UPDATE_RATE);
+
+    while (predicted_tick < target_tick) {
+        direction_history[predicted_tick % MULTI_PONG_PREDICTION_HISTORY] = predicted_direction;
+        predicted_location = step_paddle(predicted_location, predicted_direction);
+        predicted_tick++;
+    }
+}
+
+// the figures ride along with the first ping after every completed loss window
+void Client::send_ping(int64_t now) {
+    const ConnectionReport& report = get_connection_report();
+
+    Ping ping = Ping();
+    ping.set_token(token);
+    ping.set_sequence(++ping_sequence);
+    ping.set_sent_at(static_cast<uint64_t>(now));
+
+    if (report.windows != reported_windows) {
+        reported_windows = report.windows;
+        ping.set_rtt(report.rtt);
+        ping.set_jitter(report.jitter);
+        ping.set_upstream_loss(report.upstream_loss);
+        ping.set_downstream_loss(report.downstream_loss);
+    }
+
+    if (states_received.load(std::memory_order_relaxed) && report.samples) {
+        ping.set_states_received(states_received.load(std::memory_order_relaxed));
+        ping.set_state_frame(newest_state_frame.load(std::memory_order_relaxed));
+        ping.set_recent_rtt(report.rtt);
+    }
+
+    send_message_to_server(ping);
+    next_ping_at = now + MULTI_PONG_PING_INTERVAL * 1000;
+}
+
+void Client::handle_pong(const Pong& pong) {
+    uint32_t rtt = static_cast<uint32_t>(now_microseconds() - static_cast<int64_t>(pong.sent_at()));
+
+    if (connection_monitor.record(pong.sequence(), pong.received(), rtt)) {
+        const ConnectionReport& report = connection_monitor.get_report();
+        LOGGER_DEBUG("Connection rtt ", report.rtt, "us, jitter ", report.jitter, "us, loss ", report.upstream_loss * 100.0f, "% up ", report.downstream_loss * 100.0f, "% down");
+    }
+
+    connection_reports.write_buffer() = connection_monitor.get_report();
+    connection_reports.publish();
+}
+
+void Client::handle_rollback(const Rollback& rollback_message) {
+    if (rollback) return;
+
+    rollback_seed = rollback_message.seed();
+    rollback = true;
+    renderer->update_state();
+}
+
+// every window repeats what came before it from our acknowledgement on, so one that ends no later than
+// the newest already published has nothing new and would only replace it
+void Client::handle_input(const Input& input) {
+    uint32_t end = input.frame() + static_cast<uint32_t>(input.directions_size());
+    if (end < newest_remote_input) return;
+
+    newest_remote_input = end;
+    read_input_window(input, remote_inputs.write_buffer());
+    remote_inputs.publish();
+    renderer->update_state();
+}
+
+const ConnectionReport& Client::get_connection_report() {
+    connection_reports.update();
+    return connection_reports.read_buffer();
+}
+
+// rewinds the local paddle to the authoritative location and replays every tick the server has not
+// simulated yet - the acknowledged input tells us which local tick the server state corresponds to
+void Client::reconcile(const Snapshot& snapshot) {
+    uint32_t acknowledged = snapshot.sequences[identifier];
+    acknowledged_sequence = std::max(acknowledged_sequence, acknowledged);
+
+    while (!pending_inputs.empty() && pending_inputs.front().sequence < acknowledged) {
+        pending_inputs.pop_front();
+    }
+
+    uint64_t replay_from = predicted_tick;
+
+    if (acknowledged == 0 && !pending_inputs.empty()) {
+        replay_from = pending_inputs.front().tick;  // nothing applied yet, the paddle was stopped until then
+    } else if (acknowledged != 0 && !pending_inputs.empty() && pending_inputs.front().sequence == acknowledged) {
+        replay_from = pending_inputs.front().tick + (snapshot.frame - snapshot.sequence_frames[identifier]);
+    }
+
+    // the history no longer covers the gap, so the best we can do is to snap to the server
+    if (replay_from > predicted_tick || predicted_tick - replay_from >= MULTI_PONG_PREDICTION_HISTORY) {
+        predicted_location = snapshot.paddle_locations[identifier];
+        return;
+    }
+
+    float location = snapshot.paddle_locations[identifier];
+    for (uint64_t tick = replay_from; tick < predicted_tick; tick++) {
+        location = step_paddle(location, direction_history[tick % MULTI_PONG_PREDICTION_HISTORY]);
+    }
+    predicted_location = location;
+}
+
+// the returned state belongs to the render thread and is updated in place, so drawing never allocates
+const State& Client::get_state() {
+    if (!matched) {
+        return render_state;
+    }
+
+    if (rollback) {
+        return get_rollback_state();
+    }
+
+    advance_prediction();
+
+    if (input_sequence > acknowledged_sequence && predicted_tick != movement_sent_tick) {
+        send_movement();
+    }
+
+    int64_t now = now_microseconds();
+    if (now >= next_ping_at) {
+        send_ping(now);
+    }
+
+    if (received_snapshots.update()) {
+        const Snapshot& snapshot = received_snapshots.read_buffer();
+
+        if (snapshot.frame != reconciled_frame) {
+            reconciled_frame = snapshot.frame;
+            reconcile(snapshot);
+            snapshots.push(snapshot);
+        }
+    }
+
+    if (reconciled_frame == 0) {
+        return render_state;
+    }
+
+    Snapshot sample = snapshots.sample(now_microseconds());
+    render_state.set_frame(sample.frame);
+    render_state.mutable_ball()->set_x(sample.ball_x);
+    render_state.mutable_ball()->set_y(sample.ball_y);
+    render_state.mutable_player_1()->set_paddle_location(sample.paddle_locations[0]);
+    render_state.mutable_player_2()->set_paddle_location(sample.paddle_locations[1]);
+    render_state.mutable_player_1()->set_score(sample.scores[0]);
+    render_state.mutable_player_2()->set_score(sample.scores[1]);
+
+    Player* own_player = identifier == Player::PLAYER_1 ? render_state.mutable_player_1() : render_state.mutable_player_2();
+    own_player->set_paddle_location(predicted_location);
+    TRACE_MARK(FrameReady, identifier, acknowledged_sequence);
+    return render_state;
+}
+
+// the whole match runs here, so the frame drawn is simply the newest one simulated - inputs go out once per
+// tick even while waiting for the peer, or two clients that both lost a datagram would wait on each other
+const State& Client::get_rollback_state() {
+    auto now = std::chrono::steady_clock::now();
+
+    if (!rollback_session) {
+        rollback_session.emplace(rollback_seed, identifier);
+        rollback_start = now;
+        LOGGER_INFO("Simulating the match locally with rollback from seed ", rollback_seed);
+    }
+
+    if (remote_inputs.update()) {
+        rollback_session->receive(remote_inputs.read_buffer());
+    }
+
+    uint64_t target_tick = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - rollback_start).count() / MULTI_PONG_SERVER_UPDATE_RATE);
+
+    while (rollback_session->get_frame() < target_tick) {
+        if (!rollback_session->advance()) {
+            // the clock waits with the session instead of running on and bursting through frames later
+            rollback_start += std::chrono::microseconds(MULTI_PONG_SERVER_UPDATE_RATE) * (target_tick - rollback_session->get_frame());
+            break;
+        }
+    }
+
+    int64_t now_us = now_microseconds();
+    uint64_t wall_tick = static_cast<uint64_t>(now_us / MULTI_PONG_SERVER_UPDATE_RATE);
+
+    if (wall_tick != input_sent_tick) {
+        Input input = Input();
+        input.set_token(token);
+        rollback_session->fill_input(input);
+        send_message_to_server(input);
+        input_sent_tick = wall_tick;
+    }
+
+    if (now_us >= next_ping_at) {
+        send_ping(now_us);
+    }
+
+    rollback_session->fill_state(render_state);
+    return render_state;
 }
 
 void Client::update_loop() {
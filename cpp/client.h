@@ -1,11 +1,23 @@
 #pragma once
 
+#include "rollback.h"
 #include "tools/common.h"
 #include "tools/renderer.h"
+#include "tools/snapshot_buffer.h"
+#include "tools/triple_buffer.h"
+#include "tools/connection_monitor.h"
+#include "tools/reliable_channel.h"
 
 #include <string>
 #include <utility>
 #include <memory>
+#include <deque>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <optional>
+#include <vector>
 
 
 class Client {
@@ -16,21 +28,83 @@ class Client {
         socket_t coordinator_socket;
         socket_t server_socket;
         sockaddr_in server_address;
-        multi_pong::State state;
         std::string token;
         int identifier = 0;
+        std::atomic<bool> matched{ false };  // token and identifier are only read once this is set
+
+        // the network thread publishes every received state here, the render thread picks up the latest
+        TripleBuffer<Snapshot> received_snapshots;
+
+        // client-side prediction of the local paddle, only touched by the render thread - local ticks run
+        // at the server tick rate and record the direction they used so unacknowledged input can be replayed
+        struct PendingInput {
+            uint32_t sequence;
+            uint64_t tick;  // local ticks completed before the input took effect
+            multi_pong::Direction direction;
+        };
+
+        multi_pong::State render_state;
+        std::deque<PendingInput> pending_inputs;
+        std::array<multi_pong::Direction, MULTI_PONG_PREDICTION_HISTORY> direction_history{};
+        multi_pong::Direction predicted_direction = multi_pong::Direction::STOP;
+        float predicted_location = 0.5f;
+        uint64_t predicted_tick = 0;
+        std::chrono::steady_clock::time_point prediction_start;
+        uint32_t input_sequence = 0;
+        uint32_t acknowledged_sequence = 0;
+        uint64_t movement_sent_tick = 0;  // unacknowledged input is resent with its history once per tick
+        uint32_t reconciled_frame = 0;
+
+        // remote entities are drawn interpolated between snapshots, slightly in the past
+        SnapshotBuffer snapshots;
+
+        // pings go out from the render thread and their pongs are measured on the network thread, which
+        // publishes the rolling figures back for drawing and for the next report to the server
+        ConnectionMonitor connection_monitor;
+        TripleBuffer<ConnectionReport> connection_reports;
+        uint32_t ping_sequence = 0;
+        std::atomic<uint32_t> states_received{ 0 };  // reported with every ping to pace the server's states
+        std::atomic<uint32_t> newest_state_frame{ 0 };
+        uint32_t reported_windows = 0;
+        int64_t next_ping_at = 0;
+
+        // a rollback server sends the seed in place of states - the network thread hands over the peer's
+        // inputs and the session itself belongs to the render thread
+        std::atomic<bool> rollback{ false };
+        uint64_t rollback_seed = 0;  // written before rollback is set
+        TripleBuffer<InputWindow> remote_inputs;
+        uint32_t newest_remote_input = 0;  // end of the newest window published, network thread only
+        std::optional<RollbackSession> rollback_session;
+        std::chrono::steady_clock::time_point rollback_start;
+        uint64_t input_sent_tick = UINT64_MAX;
+
+        // the join and the rollback seed must arrive, so they go over a reliable channel - it is only touched by
+        // the network thread, which resends on its receive timeout
+        ReliableChannel server_channel;
+        std::vector<multi_pong::Message> delivered_messages;
 
         std::atomic<bool> active{ true };
 
         bool connect_coordinator();
         void listen_coordinator();
         void listen_server();
+        void handle_server_message(const multi_pong::Message& message);
         void send_message_to_coordinator(multi_pong::Message message);
         
         template<typename T>
-        void send_message_to_server(const T& data);
+        void send_message_to_server(const T& data, bool reliable = false);
         
+        void handle_servers(const multi_pong::Servers& servers);
         void handle_match(multi_pong::Match match);
+        void advance_prediction();
+        void send_movement();
+        void send_ping(int64_t now);
+        void handle_pong(const multi_pong::Pong& pong);
+        void handle_rollback(const multi_pong::Rollback& rollback_message);
+        void handle_input(const multi_pong::Input& input);
+        const multi_pong::State& get_rollback_state();
+        void reconcile(const Snapshot& snapshot);
+        void measure_latencies(const multi_pong::Servers& servers, multi_pong::Search& search);
         void update_loop();
 
     public:
@@ -38,5 +112,7 @@ class Client {
         ~Client();
 
         void send_move(multi_pong::Direction move);
-        const multi_pong::State& get_state() { return state; }
+        const multi_pong::State& get_state();
+        const ConnectionReport& get_connection_report();
+        std::optional<int> get_identifier() const { return matched ? std::optional<int>(identifier) : std::nullopt; }
 };
@@ -5,6 +5,9 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <chrono>
+#include <algorithm>
+#include <csignal>
 
 using namespace multi_pong;
 
@@ -12,21 +15,34 @@ Coordinator::Coordinator(int coordinator_port, std::vector<std::pair<std::string
 #ifdef _WIN32
     WSADATA wsa_data;
     if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
-        Logger::error("Failed to initialise Winsock");
+        LOGGER_ERROR("Failed to initialise Winsock");
         return;
     }
 #endif
 
+    for (size_t i = 0; i < server_list.size(); i++) {
+        server_index[server_list[i].address] = i;
+    }
+
     for (auto& server : servers) {
-        server_list[server] = multi_pong::Status_Phase::Status_Phase_UNKNOWN;
+        if (!find_server(server)) {
+            add_server(server);
+        }
+    }
+
+    for (size_t i = 0; i < server_list.size(); i++) {
+        post_probe_command(i, true);
     }
 
-    std::thread status_thread(&Coordinator::check_status, this);
-    status_thread.detach();
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, request_metrics);
+#elif defined(SIGBREAK)
+    std::signal(SIGBREAK, request_metrics);
+#endif
 
     coordinator_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (coordinator_socket < 0) {
-        Logger::error("Failed to create socket");
+        LOGGER_ERROR("Failed to create socket");
         return;
     }
 
@@ -46,100 +62,369 @@ Coordinator::Coordinator(int coordinator_port, std::vector<std::pair<std::string
 
     int bound = bind(coordinator_socket, (struct sockaddr*)&addr, sizeof(addr));
     if (bound < 0) {
-        Logger::error("Failed to bind socket to port ", port, ": ", bound);
+        LOGGER_ERROR("Failed to bind socket to port ", port, ": ", bound);
         return;
     }
 
-    Logger::debug("Socket bound successfully to port ", port);
-    listen_clients();
+    LOGGER_DEBUG("Socket bound successfully to port ", port);
+
+    registry_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (registry_socket < 0) {
+        LOGGER_ERROR("Failed to create registry socket");
+        return;
+    }
+
+    if (bind(registry_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOGGER_ERROR("Failed to bind registry socket to port ", port);
+        return;
+    }
+
+    wake_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (wake_socket < 0) {
+        LOGGER_ERROR("Failed to create wake socket");
+        return;
+    }
+
+    wake_address.sin_family = AF_INET;
+    wake_address.sin_port = 0;
+    inet_pton(AF_INET, "127.0.0.1", &wake_address.sin_addr);
+
+    socklen_t wake_address_length = sizeof(wake_address);
+    if (bind(wake_socket, (struct sockaddr*)&wake_address, sizeof(wake_address)) < 0 || getsockname(wake_socket, (struct sockaddr*)&wake_address, &wake_address_length) < 0) {
+        LOGGER_ERROR("Failed to bind wake socket");
+        return;
+    }
+
+    std::thread probe_thread(&Coordinator::probe_servers, this);
+    probe_thread.detach();
+
+    event_loop();
 }
 
 Coordinator::~Coordinator() {
     close_socket(coordinator_socket);
+    close_socket(registry_socket);
+    close_socket(wake_socket);
 #ifdef _WIN32
     WSACleanup();
 #endif
 }
 
-void Coordinator::check_status() {
+// runs on its own thread and owns nothing but its list of targets, which the event loop keeps up to date
+// with probe commands - only servers that do not send heartbeats are polled
+void Coordinator::probe_servers() {
+    std::map<size_t, std::pair<std::string, int>> targets;
+
     while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(MULTI_PONG_SERVER_CHECK_INTERVAL));
+        while (auto command = probe_commands.pop()) {
+            if (command->enabled) {
+                targets[command->server] = command->address;
+            } else {
+                targets.erase(command->server);
+            }
+        }
 
-		for (const auto& [server, status] : server_list) {
+		for (const auto& [server, address] : targets) {
             Message message;
 			message.mutable_query()->CopyFrom(Query());
-            send_message_to_server(server, message);
+
+            auto sent_at = std::chrono::steady_clock::now();
+            auto reply = send_message_to_server(address, message);
+
+            ProbeResult result = { server, std::nullopt, MULTI_PONG_LATENCY_UNKNOWN };
+            if (reply && reply->has_status()) {
+                result.phase = reply->status().phase();
+                result.rtt = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sent_at).count());
+            }
+
+            while (!probe_results.push(result)) {
+                wake();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            wake();
         }
 
-        matchmake();
+        std::this_thread::sleep_for(std::chrono::seconds(MULTI_PONG_SERVER_CHECK_INTERVAL));
     }
 }
 
-void Coordinator::matchmake() {
-    if (searching_clients.size() < 2) {
-        return;
+void Coordinator::wake() {
+    char signal = 0;
+    sendto(wake_socket, &signal, 1, 0, (sockaddr*)&wake_address, sizeof(wake_address));
+}
+
+// commands that do not fit are kept in order and retried on the next loop iteration
+void Coordinator::post_probe_command(size_t server, bool enabled) {
+    deferred_probe_commands.push_back({ server, server_list[server].address, enabled });
+
+    while (!deferred_probe_commands.empty() && probe_commands.push(deferred_probe_commands.front())) {
+        deferred_probe_commands.pop_front();
     }
+}
 
-	std::pair<std::string, int> server;
-	Tokens tokens;
+void Coordinator::process_probe_results() {
+    while (!deferred_probe_commands.empty() && probe_commands.push(deferred_probe_commands.front())) {
+        deferred_probe_commands.pop_front();
+    }
 
-    if (!get_prepared_server(server, tokens)) {
-        return;
+    while (auto result = probe_results.pop()) {
+        GameServer& server = server_list[result->server];
+
+        // the server may have registered while the probe was in flight, heartbeats take precedence
+        if (server.registered) {
+            continue;
+        }
+
+        server.rtt = result->rtt;
+
+        if (!result->phase) {
+            LOGGER_INFO("Server ", server.address.first, ":", server.address.second, " is unresponsive");
+            server.phase = Status::Phase::Status_Phase_UNKNOWN;
+            continue;
+        }
+
+        if (*result->phase == Status::Phase::Status_Phase_WAITING) {
+            LOGGER_INFO("Server ", server.address.first, ":", server.address.second, " is available");
+        } else {
+            LOGGER_INFO("Server ", server.address.first, ":", server.address.second, " is busy");
+        }
+
+        // a pooled server is only ever seen as preparing here, anything else is caught by the refill
+        if (!(server.pooled && *result->phase == Status::Phase::Status_Phase_PREPARING)) {
+            server.phase = *result->phase;
+        }
     }
+}
 
-    std::vector<std::pair<std::string, Player::Identifier>> token_pairs = {
-        { tokens.token_1(), Player::Identifier::Player_Identifier_PLAYER_1 },
-        { tokens.token_2(), Player::Identifier::Player_Identifier_PLAYER_2 }
-    };
+// pairs searching clients for as long as there are prepared servers to send them to
+void Coordinator::matchmake() {
+    while (searching_clients.size() >= 2) {
+        std::pair<std::string, int> server;
+        Tokens tokens;
+
+        if (!get_prepared_server(searching_clients[0], searching_clients[1], server, tokens)) {
+            if (!metrics.waiting_for_pool) {
+                metrics.waiting_for_pool = true;
+                metrics.pool_misses++;
+            }
+            return;
+        }
+
+        auto now = TimerWheel::clock::now();
+        auto second_search = std::max(search_started_at[searching_clients[0]], search_started_at[searching_clients[1]]);
+        metrics.waiting_for_pool = false;
 
-    for (auto& [token, player_id] : token_pairs) {
-        Player player;
-        player.set_identifier(player_id);
-        player.set_paddle_direction(Direction::STOP);
-        player.set_paddle_location(0.5f);
-        player.set_score(0);
+        std::vector<std::pair<std::string, Player::Identifier>> token_pairs = {
+            { tokens.token_1(), Player::Identifier::Player_Identifier_PLAYER_1 },
+            { tokens.token_2(), Player::Identifier::Player_Identifier_PLAYER_2 }
+        };
+
+        for (auto& [token, player_id] : token_pairs) {
+            Player player;
+            player.set_identifier(player_id);
+            player.set_paddle_direction(Direction::STOP);
+            player.set_paddle_location(0.5f);
+            player.set_score(0);
+
+            Match match;
+            match.set_host(server.first);
+            match.set_port(server.second);
+            match.set_token(token);
+            match.mutable_player()->CopyFrom(player);
+
+            socket_t client = searching_clients.front();
+            searching_clients.pop_front();
+            client_latencies.erase(client);
 
-        Match match;
-        match.set_host(server.first);
-        match.set_port(server.second);
-        match.set_token(token);
-        match.mutable_player()->CopyFrom(player);
+            metrics.queue_wait.record(std::chrono::duration_cast<std::chrono::microseconds>(now - search_started_at[client]).count());
+            search_started_at.erase(client);
 
-        socket_t client = searching_clients.front();
-		searching_clients.pop_front();
+            Message match_message = Message();
+            match_message.mutable_match()->CopyFrom(match);
 
-		Message match_message = Message();
-		match_message.mutable_match()->CopyFrom(match);
+            send_message_to_client(client, match_message);
 
-        send_message_to_client(client, match_message);
+            LOGGER_INFO("Forwarded match on ", server.first, ":", server.second, " to client with token ", token);
+        }
 
-        Logger::info("Forwarded match on ", server.first, ":", server.second, " to client with token ", token);
+        metrics.search_to_match.record(std::chrono::duration_cast<std::chrono::microseconds>(TimerWheel::clock::now() - second_search).count());
+        metrics.matches++;
     }
 }
 
-bool Coordinator::get_prepared_server(std::pair<std::string, int>& prepared_server, Tokens& tokens) {
-    Message prepare_message = Message();
-    Prepare prepare;
+std::optional<size_t> Coordinator::find_server(const std::pair<std::string, int>& address) {
+    auto it = server_index.find(address);
+    if (it == server_index.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+size_t Coordinator::add_server(const std::pair<std::string, int>& address) {
+    server_list.push_back({ address });
+    server_index[address] = server_list.size() - 1;
+    return server_list.size() - 1;
+}
+
+// a latency the client did not report is estimated from the coordinator's own round trip to that server
+uint32_t Coordinator::estimate_latency(socket_t client, size_t server) {
+    const std::vector<uint32_t>& latencies = client_latencies[client];
+    uint32_t rtt = server < latencies.size() ? latencies[server] : MULTI_PONG_LATENCY_UNKNOWN;
+    return rtt != MULTI_PONG_LATENCY_UNKNOWN ? rtt : server_list[server].rtt;
+}
+
+// takes the pooled server that minimises the worse of the two players' round trip times, so pairing
+// never waits on the network - the pool is topped up again in the background
+bool Coordinator::get_prepared_server(socket_t client_1, socket_t client_2, std::pair<std::string, int>& prepared_server, Tokens& tokens) {
+    if (token_pool.empty()) {
+        return false;
+    }
 
-	prepare.set_secret(secret);
-    prepare_message.mutable_prepare()->CopyFrom(prepare);
+    size_t best = 0;
+    uint32_t best_score = MULTI_PONG_LATENCY_UNKNOWN;
 
-    for (const auto& [server, status] : server_list) {
-        if (status != Status::Phase::Status_Phase_WAITING) {
+    for (size_t i = 0; i < token_pool.size(); i++) {
+        size_t server = token_pool[i].server;
+        uint32_t score = std::max(estimate_latency(client_1, server), estimate_latency(client_2, server));
+        if (score < best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    GameServer& server = server_list[token_pool[best].server];
+    server.pooled = false;
+    prepared_server = server.address;
+    tokens = token_pool[best].tokens;
+
+    token_pool.erase(token_pool.begin() + best);
+    refill_token_pool();
+    return true;
+}
+
+void Coordinator::refill_token_pool() {
+    auto now = TimerWheel::clock::now();
+    size_t pending = 0;
+
+    for (auto it = token_pool.begin(); it != token_pool.end();) {
+        GameServer& server = server_list[it->server];
+
+        // a polled server reporting waiting again has restarted and forgotten the tokens
+        if (server.phase == Status::Phase::Status_Phase_WAITING || server.phase == Status::Phase::Status_Phase_UNKNOWN) {
+            LOGGER_INFO("Dropped prepared server ", server.address.first, ":", server.address.second, " from the token pool: server restarted");
+            server.pooled = false;
+            it = token_pool.erase(it);
             continue;
         }
 
-        auto token_message = send_message_to_server(server, prepare_message);
-        if (token_message && token_message->has_tokens()) {
-            prepared_server = server;
-			tokens = token_message->tokens();
-            return true;
+        // prepared servers release their tokens when nobody joins for a while, so pooled ones are prepared
+        // again well before that
+        if (now - server.prepare_sent_at >= std::chrono::milliseconds(MULTI_PONG_PREPARE_EXPIRY / 2)) {
+            send_prepare(it->server);
         }
+        ++it;
+    }
+
+    for (size_t i = 0; i < server_list.size() && token_pool.size() + pending < MULTI_PONG_TOKEN_POOL_SIZE; i++) {
+        GameServer& server = server_list[i];
+
+        if (server.pooled) {
+            continue;
+        }
+
+        if (server.prepare_pending && now - server.prepare_sent_at >= std::chrono::seconds(MULTI_PONG_SERVER_CHECK_TIMEOUT)) {
+            server.prepare_pending = false;
+            metrics.prepare_timeouts++;
+        }
+
+        if (server.prepare_pending) {
+            pending++;
+            continue;
+        }
+
+        if (server.phase != Status::Phase::Status_Phase_WAITING) {
+            continue;
+        }
+
+        send_prepare(i);
+        pending++;
+    }
+}
+
+void Coordinator::send_prepare(size_t index) {
+    GameServer& server = server_list[index];
+
+    Prepare prepare;
+    prepare.set_secret(secret);
+
+    Message message = Message();
+    message.mutable_prepare()->CopyFrom(prepare);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server.address.second);
+    inet_pton(AF_INET, server.address.first.c_str(), &address.sin_addr);
+
+    // resent by the channel until the server acknowledges it, the timeout below only covers a server that never does
+    // the request is pending from the moment the channel holds it, a failed first send is only retried by the channel
+    auto now = TimerWheel::clock::now();
+    server.channel.send(message, now);
+    server.prepare_pending = true;
+    server.prepare_sent_at = now;
+    server.refreshing = server.pooled;
+
+    std::string serialised_message = message.SerializeAsString();
+    if (sendto(registry_socket, serialised_message.c_str(), static_cast<int>(serialised_message.size()), 0, (sockaddr*)&address, sizeof(address)) < 0) {
+        LOGGER_WARNING("Failed to send preparation request to server ", server.address.first, ":", server.address.second);
+    }
+}
+
+void Coordinator::handle_tokens(const Tokens& tokens, const sockaddr_in& address) {
+    auto index = find_server({ address_string(address), ntohs(address.sin_port) });
+    if (!index) {
+        LOGGER_WARNING("Received tokens from unknown server ", address_string(address), ":", ntohs(address.sin_port));
+        return;
+    }
+
+    GameServer& server = server_list[*index];
+
+    if (server.prepare_pending) {
+        auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(TimerWheel::clock::now() - server.prepare_sent_at);
+        server.rtt = static_cast<uint32_t>(rtt.count());
+        server.prepare_pending = false;
+        metrics.prepare_rtt.record(rtt.count());
+    }
+
+    // a refresh may be answered after its server was handed out, which must not pool it a second time
+    if (server.refreshing) {
+        server.refreshing = false;
+        return;
+    }
+
+    // late replies are still kept - the server is holding the slot for these tokens either way
+    if (server.pooled) {
+        return;
     }
-    return false;
+
+    server.pooled = true;
+    server.phase = Status::Phase::Status_Phase_PREPARING;
+    token_pool.push_back({ *index, tokens });
+
+    LOGGER_DEBUG("Added server ", server.address.first, ":", server.address.second, " to the token pool (", token_pool.size(), "/", MULTI_PONG_TOKEN_POOL_SIZE, ")");
 }
 
-std::optional<Message> Coordinator::send_message_to_server(std::pair<std::string, int> server, Message message) {
+void Coordinator::drop_prepared_server(size_t index, const char* reason) {
+    GameServer& server = server_list[index];
+    if (!server.pooled) {
+        return;
+    }
+
+    LOGGER_INFO("Dropped prepared server ", server.address.first, ":", server.address.second, " from the token pool: ", reason);
+    server.pooled = false;
+    token_pool.erase(std::remove_if(token_pool.begin(), token_pool.end(), [index](const PreparedServer& prepared) { return prepared.server == index; }), token_pool.end());
+}
+
+std::optional<Message> Coordinator::send_message_to_server(const std::pair<std::string, int>& server, Message message) {
     socket_t server_socket = socket(AF_INET, SOCK_DGRAM, 0);
     if (server_socket < 0) {
         return std::nullopt;
@@ -153,7 +438,7 @@ std::optional<Message> Coordinator::send_message_to_server(std::pair<std::string
     std::string serialised_message = message.SerializeAsString();
     int sent = sendto(server_socket, serialised_message.c_str(), static_cast<int>(serialised_message.size()), 0, (sockaddr*)&address, sizeof(address));
     if (sent < 0) {
-        Logger::error("Failed to send message to server ", server.first, ":", server.second);
+        LOGGER_ERROR("Failed to send message to server ", server.first, ":", server.second);
         close_socket(server_socket);
         return std::nullopt;
     }
@@ -176,7 +461,6 @@ std::optional<Message> Coordinator::send_message_to_server(std::pair<std::string
     close_socket(server_socket);
 
     if (received < 0) {
-        Logger::info("Server ", server.first, ":", server.second, " is unresponsive");
         return std::nullopt;
     }
 
@@ -184,82 +468,101 @@ std::optional<Message> Coordinator::send_message_to_server(std::pair<std::string
 
     Message received_message;
     if (!received_message.ParseFromArray(buffer, received)) {
-        Logger::warning("Failed to process data into a protobuf message: ", buffer);
+        LOGGER_WARNING("Failed to process data into a protobuf message: ", buffer);
         return std::nullopt;
     }
 
     switch (received_message.content_case()) {
         case Message::kStatus:
-            if (received_message.status().phase() == Status::Phase::Status_Phase_WAITING) {
-                Logger::info("Server ", server.first, ":", server.second, " is available");
-            }
-            else {
-                Logger::info("Server ", server.first, ":", server.second, " is busy");
-            }
-            server_list[server] = received_message.status().phase();
-            return received_message;
-        case Message::kTokens:
-            server_list[server] = Status::Phase::Status_Phase_STARTED;
             return received_message;
         default:
-            Logger::warning("Invalid message type ", received_message.content_case(), " from server ", server.first, ":", server.second);
+            LOGGER_WARNING("Invalid message type ", received_message.content_case(), " from server ", server.first, ":", server.second);
             return received_message;
         };
 }
 
-void Coordinator::listen_clients() {
+void Coordinator::event_loop() {
     listen(coordinator_socket, SOMAXCONN);
-    Logger::info("Starting listening on 0.0.0.0:", port);
+    LOGGER_INFO("Starting listening on 0.0.0.0:", port);
 
-    while (true) {
-		fd_set read_fds;
-		FD_ZERO(&read_fds);
+    // poll rather than select, since descriptors past FD_SETSIZE are common with thousands of clients
+    enum { LISTENER, REGISTRY, WAKE, FIRST_CLIENT };
+    std::vector<pollfd> poll_fds;
 
-		FD_SET(coordinator_socket, &read_fds);
-        socket_t max_fd = coordinator_socket;
+    while (true) {
+        poll_fds.clear();
+        poll_fds.push_back({ coordinator_socket, POLLIN, 0 });
+        poll_fds.push_back({ registry_socket, POLLIN, 0 });
+        poll_fds.push_back({ wake_socket, POLLIN, 0 });
 
         for (auto client : clients) {
-            FD_SET(client, &read_fds);
-			if (client > max_fd) {
-                max_fd = client;
-            }
+            poll_fds.push_back({ client, POLLIN, 0 });
+        }
+
+        // wake up at the timer resolution so that expired servers are noticed without any traffic
+        int ready = poll_sockets(poll_fds.data(), poll_fds.size(), MULTI_PONG_TIMER_RESOLUTION);
+
+        auto readable = [&](size_t index) {
+            return (poll_fds[index].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+        };
+
+        if (ready > 0 && readable(WAKE)) {
+            char signal;
+            recv(wake_socket, &signal, 1, 0);
+        }
+
+        if (metrics_requested.exchange(false)) {
+            dump_metrics();
         }
 
-        if (select(static_cast<int>(max_fd) + 1, &read_fds, nullptr, nullptr, nullptr) < 0) {
+        process_probe_results();
+        heartbeat_timers.advance(TimerWheel::clock::now(), [this](uint64_t server) { expire_server(static_cast<size_t>(server)); });
+        flush_reliable_channels();
+
+        // every pass rather than only when idle, since a steady stream of clients would otherwise keep pooled
+        // tokens from being prepared again before they expire - sends are rate limited by prepare_sent_at
+        refill_token_pool();
+
+        if (ready <= 0) {
+            matchmake();
             continue;
 		}
 
-        if (FD_ISSET(coordinator_socket, &read_fds)) {
+        if (readable(REGISTRY)) {
+            receive_registrations();
+        }
+
+        if (readable(LISTENER)) {
             sockaddr_in client_addr{};
             socklen_t len = sizeof(client_addr);
 
 #ifdef _WIN32
             SOCKET client_socket = accept(coordinator_socket, (sockaddr*)&client_addr, &len);
             if (client_socket == INVALID_SOCKET) {
-                Logger::warning("Failed to accept client connection: ", WSAGetLastError());
+                LOGGER_WARNING("Failed to accept client connection: ", WSAGetLastError());
                 continue;
             }
 #else
             socket_t client_socket = accept(coordinator_socket, (sockaddr*)&client_addr, &len);
             if (client_socket < 0) {
-                Logger::warning("Failed to accept client connection: ", errno);
+                LOGGER_WARNING("Failed to accept client connection: ", errno);
                 continue;
             }
 #endif
 
             clients.push_back(client_socket);
 
-            Logger::info("Client ", address_string(client_addr), ":", ntohs(client_addr.sin_port), " connected");
+            LOGGER_INFO("Client ", address_string(client_addr), ":", ntohs(client_addr.sin_port), " connected");
         }
 
-        for (auto it = clients.begin(); it != clients.end();) {
-            socket_t client_socket = *it;
-
-            if (!FD_ISSET(client_socket, &read_fds)) {
-                ++it;
+        // clients accepted above are not in this poll yet and are read on the next iteration
+        for (size_t index = FIRST_CLIENT; index < poll_fds.size(); index++) {
+            if (!readable(index)) {
                 continue;
             }
 
+            socket_t client_socket = poll_fds[index].fd;
+
             char buffer[MULTI_PONG_SERVER_BUFFER];
             int bytes = recv(client_socket, buffer, sizeof(buffer), 0);
 
@@ -268,10 +571,12 @@ void Coordinator::listen_clients() {
             getpeername(client_socket, (sockaddr*)&client_addr, &len);
 
             if (bytes <= 0) {
-                Logger::info("Client ", address_string(client_addr), ":", ntohs(client_addr.sin_port), " disconnected");
+                LOGGER_INFO("Client ", address_string(client_addr), ":", ntohs(client_addr.sin_port), " disconnected");
                 close_socket(client_socket);
                 searching_clients.erase(std::remove(searching_clients.begin(), searching_clients.end(), client_socket), searching_clients.end());
-                it = clients.erase(it);
+                client_latencies.erase(client_socket);
+                search_started_at.erase(client_socket);
+                clients.erase(std::find(clients.begin(), clients.end(), client_socket));
                 continue;
             }
 
@@ -279,30 +584,232 @@ void Coordinator::listen_clients() {
                 buffer[bytes] = '\0';
             }
 
-            Logger::debug("Received: ", buffer);
+            LOGGER_DEBUG("Received: ", buffer);
 
             Message message;
             if (!message.ParseFromArray(buffer, bytes)) {
-				Logger::warning("Failed to process data into a protobuf message: ", buffer);
-                it++;
+				LOGGER_WARNING("Failed to process data into a protobuf message: ", buffer);
                 continue;
             }
 
             switch (message.content_case()) {
                 case Message::kSearch:
-                    Logger::info("Added client ", address_string(client_addr), ":", ntohs(client_addr.sin_port), " as a searching player");
-                    searching_clients.push_back(client_socket);
+                    LOGGER_INFO("Added client ", address_string(client_addr), ":", ntohs(client_addr.sin_port), " as a searching player");
+                    handle_search(client_socket, message.search());
+                    break;
+                case Message::kQuery:
+                    send_server_list(client_socket);
                     break;
                 default:
-                    Logger::warning("Invalid message type ", message.content_case(), " from client ", address_string(client_addr), ":", ntohs(client_addr.sin_port));
+                    LOGGER_WARNING("Invalid message type ", message.content_case(), " from client ", address_string(client_addr), ":", ntohs(client_addr.sin_port));
                     break;
 			};
+        }
+
+        matchmake();
+    }
+}
+
+void Coordinator::receive_registrations() {
+    char buffer[MULTI_PONG_SERVER_BUFFER];
+    sockaddr_in address{};
+    socklen_t address_length = sizeof(address);
+
+    int received = recvfrom(registry_socket, buffer, sizeof(buffer), 0, (sockaddr*)&address, &address_length);
+    if (received < 0) {
+        return;
+    }
+
+    Message message;
+    if (!message.ParseFromArray(buffer, received)) {
+        LOGGER_WARNING("Failed to process registry data into a protobuf message from ", address_string(address), ":", ntohs(address.sin_port));
+        return;
+    }
+
+    // heartbeats stay unreliable, a server the coordinator does not know yet has nothing reliable to send
+    auto index = find_server({ address_string(address), ntohs(address.sin_port) });
+    if (!message.has_reliable() || !index) {
+        handle_registration(message, address);
+        return;
+    }
+
+    std::vector<Message> delivered;
+    if (server_list[*index].channel.receive(message, TimerWheel::clock::now(), delivered) != ReliableChannel::Receipt::Delivered) {
+        return;
+    }
+
+    for (const Message& delivered_message : delivered) {
+        handle_registration(delivered_message, address);
+    }
+}
 
-            it++;
+void Coordinator::flush_reliable_channels() {
+    auto now = TimerWheel::clock::now();
+
+    for (GameServer& server : server_list) {
+        bool delivering = server.channel.flush(now, [&](const Message& message) {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(server.address.second);
+            inet_pton(AF_INET, server.address.first.c_str(), &address.sin_addr);
+
+            std::string serialised_message = message.SerializeAsString();
+            sendto(registry_socket, serialised_message.c_str(), static_cast<int>(serialised_message.size()), 0, (sockaddr*)&address, sizeof(address));
+        });
+
+        if (!delivering) {
+            LOGGER_WARNING("Gave up on control messages to server ", server.address.first, ":", server.address.second, " after ", MULTI_PONG_RELIABLE_ATTEMPTS, " attempts");
         }
     }
 }
 
+void Coordinator::handle_registration(const Message& message, const sockaddr_in& address) {
+    switch (message.content_case()) {
+        case Message::kHeartbeat:
+            handle_heartbeat(message.heartbeat(), address);
+            break;
+        case Message::kTokens:
+            handle_tokens(message.tokens(), address);
+            break;
+        default:
+            LOGGER_WARNING("Invalid message type ", message.content_case(), " from server ", address_string(address), ":", ntohs(address.sin_port));
+            break;
+    }
+}
+
+void Coordinator::handle_heartbeat(const Heartbeat& heartbeat, const sockaddr_in& address) {
+    std::pair<std::string, int> server_address = { address_string(address), static_cast<int>(heartbeat.port()) };
+
+    auto index = find_server(server_address);
+    if (!index) {
+        index = add_server(server_address);
+    }
+
+    GameServer& server = server_list[*index];
+
+    if (server.pooled && heartbeat.phase() == Status::Phase::Status_Phase_WAITING) {
+        drop_prepared_server(*index, "server restarted");
+    }
+
+    if (!server.registered) {
+        LOGGER_INFO("Server ", server_address.first, ":", server_address.second, " registered");
+        post_probe_command(*index, false);
+    } else if (server.phase != heartbeat.phase()) {
+        LOGGER_DEBUG("Server ", server_address.first, ":", server_address.second, " moved to phase ", heartbeat.phase());
+    }
+
+    server.registered = true;
+    server.phase = heartbeat.phase();
+    server.capacity = heartbeat.capacity();
+    server.load = heartbeat.load();
+    server.expires_at = TimerWheel::clock::now() + std::chrono::milliseconds(MULTI_PONG_HEARTBEAT_EXPIRY);
+
+    if (server.phase == Status::Phase::Status_Phase_WAITING) {
+        refill_token_pool();
+    }
+
+    // refreshing only moves the deadline, the pending timer reschedules itself when it fires early
+    if (!server.expiry_scheduled) {
+        server.expiry_scheduled = true;
+        heartbeat_timers.schedule(*index, server.expires_at);
+    }
+}
+
+void Coordinator::expire_server(size_t index) {
+    GameServer& server = server_list[index];
+    server.expiry_scheduled = false;
+
+    if (!server.registered) {
+        return;
+    }
+
+    if (server.expires_at > TimerWheel::clock::now()) {
+        server.expiry_scheduled = true;
+        heartbeat_timers.schedule(index, server.expires_at);
+        return;
+    }
+
+    LOGGER_INFO("Server ", server.address.first, ":", server.address.second, " stopped sending heartbeats");
+    drop_prepared_server(index, "server expired");
+    post_probe_command(index, true);
+    server.registered = false;
+    server.phase = Status::Phase::Status_Phase_UNKNOWN;
+    server.capacity = 0;
+    server.load = 0.0f;
+}
+
+void Coordinator::handle_search(socket_t client_socket, const Search& search) {
+    std::vector<uint32_t>& latencies = client_latencies[client_socket];
+    latencies.assign(server_list.size(), MULTI_PONG_LATENCY_UNKNOWN);
+
+    for (const auto& latency : search.latencies()) {
+        auto server = find_server({ latency.endpoint().host(), static_cast<int>(latency.endpoint().port()) });
+        if (server) {
+            latencies[*server] = latency.rtt();
+        }
+    }
+
+    if (std::find(searching_clients.begin(), searching_clients.end(), client_socket) == searching_clients.end()) {
+        searching_clients.push_back(client_socket);
+        search_started_at[client_socket] = TimerWheel::clock::now();
+    }
+}
+
+// candidates are capped so that both this list and the client's latency report fit into one buffer,
+// pooled servers come first since matches are only ever assigned from the pool
+void Coordinator::send_server_list(socket_t client_socket) {
+    Servers servers;
+
+    auto add_candidate = [&servers](const GameServer& server) {
+        Endpoint* endpoint = servers.add_endpoints();
+        endpoint->set_host(server.address.first);
+        endpoint->set_port(server.address.second);
+    };
+
+    for (const auto& prepared : token_pool) {
+        add_candidate(server_list[prepared.server]);
+    }
+
+    for (const auto& server : server_list) {
+        if (servers.endpoints_size() >= MULTI_PONG_LATENCY_CANDIDATES) {
+            break;
+        }
+        if (server.phase == Status::Phase::Status_Phase_WAITING && !server.pooled) {
+            add_candidate(server);
+        }
+    }
+
+    Message message;
+    message.mutable_servers()->CopyFrom(servers);
+    send_message_to_client(client_socket, message);
+}
+
+void Coordinator::request_metrics(int signal) {
+    metrics_requested = true;
+    std::signal(signal, request_metrics);
+}
+
+void Coordinator::dump_metrics() {
+    auto report = [](const char* name, const Histogram& histogram) {
+        LOGGER_INFO(name, " (us): count=", histogram.count(), " min=", histogram.min(), " p50=", histogram.percentile(50), " p90=", histogram.percentile(90),
+            " p99=", histogram.percentile(99), " p99.9=", histogram.percentile(99.9), " max=", histogram.max());
+    };
+
+    size_t phases[4] = {};
+    for (const auto& server : server_list) {
+        phases[std::clamp(static_cast<int>(server.phase), 0, 3)]++;
+    }
+
+    LOGGER_INFO("Clients: connected=", clients.size(), " searching=", searching_clients.size(), " matches=", metrics.matches);
+    LOGGER_INFO("Servers: unknown=", phases[Status::Phase::Status_Phase_UNKNOWN], " waiting=", phases[Status::Phase::Status_Phase_WAITING],
+        " preparing=", phases[Status::Phase::Status_Phase_PREPARING], " started=", phases[Status::Phase::Status_Phase_STARTED],
+        " pooled=", token_pool.size(), "/", MULTI_PONG_TOKEN_POOL_SIZE);
+    LOGGER_INFO("Token pool: misses=", metrics.pool_misses, " prepare timeouts=", metrics.prepare_timeouts);
+    report("Queue wait", metrics.queue_wait);
+    report("Prepare round trip", metrics.prepare_rtt);
+    report("Search to match", metrics.search_to_match);
+}
+
 void Coordinator::send_message_to_client(socket_t client_socket, const Message& message) {
     std::string serialised_message = message.SerializeAsString();
     send(client_socket, serialised_message.c_str(), static_cast<int>(serialised_message.size()), 0);
@@ -1,36 +1,123 @@
 #pragma once
 
 #include "tools/common.h"
+#include "tools/timer_wheel.h"
+#include "tools/spsc_queue.h"
+#include "tools/metrics.h"
+#include "tools/reliable_channel.h"
 
 #include <string>
+#include <unordered_map>
 #include <map>
 #include <vector>
 #include <deque>
 #include <optional>
 #include <utility>
+#include <cstdint>
+#include <atomic>
 
 
+// all matchmaking state is owned by the event loop thread - the prober only ever talks to it through
+// the two queues below and wakes it up with a datagram on the loopback wake socket
 class Coordinator {
     private:
+        struct GameServer {
+            std::pair<std::string, int> address;
+            multi_pong::Status_Phase phase = multi_pong::Status_Phase::Status_Phase_UNKNOWN;
+            uint32_t rtt = MULTI_PONG_LATENCY_UNKNOWN;  // coordinator to server, microseconds
+            bool registered = false;  // sends heartbeats, so it is not polled
+            uint32_t capacity = 0;
+            float load = 0.0f;
+            TimerWheel::clock::time_point expires_at{};
+            bool expiry_scheduled = false;
+            bool prepare_pending = false;
+            TimerWheel::clock::time_point prepare_sent_at{};
+            bool pooled = false;
+            bool refreshing = false;  // the pending prepare only keeps tokens already held from expiring
+            ReliableChannel channel{};  // prepares out and tokens back
+        };
+
+        struct PreparedServer {
+            size_t server;
+            multi_pong::Tokens tokens;
+        };
+
+        struct ProbeCommand {
+            size_t server;
+            std::pair<std::string, int> address;
+            bool enabled;
+        };
+
+        struct ProbeResult {
+            size_t server;
+            std::optional<multi_pong::Status_Phase> phase;
+            uint32_t rtt;
+        };
+
+        // latencies are in microseconds, everything is only touched by the event loop
+        struct Metrics {
+            Histogram queue_wait;  // search to being paired
+            Histogram prepare_rtt;  // prepare to tokens
+            Histogram search_to_match;  // second search of a pair to both matches sent
+            uint64_t matches = 0;
+            uint64_t pool_misses = 0;  // pairs that had to wait for a prepared server
+            uint64_t prepare_timeouts = 0;
+            bool waiting_for_pool = false;
+        };
+
+        inline static std::atomic<bool> metrics_requested{ false };
+
         int port;
         socket_t coordinator_socket;
+        socket_t registry_socket;
+        socket_t wake_socket;
+        sockaddr_in wake_address{};
+        SpscQueue<ProbeCommand, MULTI_PONG_COORDINATOR_QUEUE> probe_commands;
+        SpscQueue<ProbeResult, MULTI_PONG_COORDINATOR_QUEUE> probe_results;
+        std::deque<ProbeCommand> deferred_probe_commands;
         std::string secret = "";
         std::vector<socket_t> clients;
         std::deque<socket_t> searching_clients;
-        std::map<std::pair<std::string, int>, multi_pong::Status_Phase> server_list = {
-            { {"127.0.0.1", 5000}, multi_pong::Status_Phase::Status_Phase_UNKNOWN },
-            { {"127.0.0.1", 5001}, multi_pong::Status_Phase::Status_Phase_UNKNOWN },
-            { {"127.0.0.1", 5002}, multi_pong::Status_Phase::Status_Phase_UNKNOWN },
-            { {"127.0.0.1", 5003}, multi_pong::Status_Phase::Status_Phase_UNKNOWN },
-            { {"127.0.0.1", 5004}, multi_pong::Status_Phase::Status_Phase_UNKNOWN },
+        // latency vectors are indexed by position in server_list, so servers are only ever appended
+        std::unordered_map<socket_t, std::vector<uint32_t>> client_latencies;
+        std::unordered_map<socket_t, TimerWheel::clock::time_point> search_started_at;
+        Metrics metrics;
+        std::vector<GameServer> server_list = {
+            { {"127.0.0.1", 5000} },
+            { {"127.0.0.1", 5001} },
+            { {"127.0.0.1", 5002} },
+            { {"127.0.0.1", 5003} },
+            { {"127.0.0.1", 5004} },
         };
+        std::map<std::pair<std::string, int>, size_t> server_index;
+        std::vector<PreparedServer> token_pool;
+        TimerWheel heartbeat_timers{ std::chrono::milliseconds(MULTI_PONG_TIMER_RESOLUTION), MULTI_PONG_TIMER_SLOTS };
 
-        void listen_clients();
-        void check_status();
+        void event_loop();
+        void probe_servers();
+        void wake();
+        void post_probe_command(size_t server, bool enabled);
+        void process_probe_results();
         void matchmake();
-        bool get_prepared_server(std::pair<std::string, int>& server, multi_pong::Tokens& tokens);
+        void handle_search(socket_t client, const multi_pong::Search& search);
+        void handle_heartbeat(const multi_pong::Heartbeat& heartbeat, const sockaddr_in& address);
+        void expire_server(size_t server);
+        void receive_registrations();
+        void handle_registration(const multi_pong::Message& message, const sockaddr_in& address);
+        void flush_reliable_channels();
+        size_t add_server(const std::pair<std::string, int>& address);
+        void send_server_list(socket_t client);
+        std::optional<size_t> find_server(const std::pair<std::string, int>& address);
+        uint32_t estimate_latency(socket_t client, size_t server);
+        void refill_token_pool();
+        void send_prepare(size_t server);
+        void handle_tokens(const multi_pong::Tokens& tokens, const sockaddr_in& address);
+        void drop_prepared_server(size_t server, const char* reason);
+        bool get_prepared_server(socket_t client_1, socket_t client_2, std::pair<std::string, int>& server, multi_pong::Tokens& tokens);
+        void dump_metrics();
+        static void request_metrics(int signal);
         void send_message_to_client(socket_t client, const multi_pong::Message&);
-        std::optional<multi_pong::Message> send_message_to_server(std::pair<std::string, int> server, multi_pong::Message message);
+        std::optional<multi_pong::Message> send_message_to_server(const std::pair<std::string, int>& server, multi_pong::Message message);
 
     public:
         Coordinator(int port, std::vector<std::pair<std::string, int>> addresses);
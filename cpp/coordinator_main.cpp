@@ -0,0 +1,73 @@
+#include "coordinator.h"
+#include "tools/logger.h"
+#include "tools/common.h"
+#include "tools/options.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <iostream>
+
+struct Arguments {
+	bool invalid = false;
+	int port = MULTI_PONG_COORDINATOR_PORT;
+	std::vector<std::pair<std::string, int>> server_addresses;
+	LogOptions log_options;
+};
+
+static Arguments parse_arguments(int argc, char** argv) {
+	Arguments arguments;
+	arguments.invalid = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+
+		if (OptionResult result = parse_log_option(argc, argv, i, arguments.log_options); result != OptionResult::Unknown) {
+			if (result == OptionResult::Invalid) return arguments;
+		} else if (argument == "--port") {
+			std::optional<int> port = i + 1 < argc ? parse_port(argv[++i]) : std::nullopt;
+			if (!port) {
+				LOGGER_ERROR("Specify a valid port number with --port <1-65535>");
+				return arguments;
+			}
+			arguments.port = *port;
+		} else if (argument == "--server-address") {
+			if (i + 1 < argc) {
+				if (auto addresses = parse_address_range(argv[++i])) {
+					arguments.server_addresses.insert(arguments.server_addresses.end(), addresses->begin(), addresses->end());
+				} else {
+					LOGGER_ERROR("Invalid server address: ", argv[i]);
+					return arguments;
+				}
+			} else {
+				LOGGER_ERROR("Specify multiple server addresses with --server-address <address:port>");
+				return arguments;
+			}
+		} else if (argument == "--help") {
+			std::cout <<
+				"usage: " << argv[0] << " [options]\n\n"
+				"options:\n"
+				"  --port <1-65535>              port to listen on <" << MULTI_PONG_COORDINATOR_PORT << ">\n"
+				"  --server-address <host:port>  (multiple) game servers to poll, host:first-last for a range\n"
+				"                                of ports - servers that send heartbeats need not be listed\n"
+				<< LOG_OPTIONS_HELP <<
+				"  --help                        show help\n";
+			return arguments;
+		}
+	}
+
+	arguments.invalid = false;
+	return arguments;
+}
+
+int main(int argc, char** argv) {
+	Arguments arguments = parse_arguments(argc, argv);
+
+	if (arguments.invalid || !apply_log_options(arguments.log_options)) {
+		return -1;
+	}
+
+	Coordinator coordinator = Coordinator(arguments.port, arguments.server_addresses);
+	return 0;
+}
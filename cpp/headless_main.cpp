@@ -0,0 +1,139 @@
+#include "client.h"
+#include "loadgen.h"
+#include "tools/logger.h"
+#include "tools/common.h"
+#include "tools/options.h"
+#include "tools/renderer_headless.h"
+
+#include <optional>
+#include <string>
+#include <iostream>
+#include <memory>
+#include <cstdint>
+
+// the client roles that never open a window - soak runs and load tests, built without GLFW
+
+struct Arguments {
+	bool invalid = false;
+	LoadProfile load_profile;
+	HeadlessInput headless_input;
+	FramePacing frame_pacing;
+	std::optional<int> port;
+	std::optional<std::string> host;
+	LogOptions log_options;
+};
+
+static Arguments parse_arguments(int argc, char** argv) {
+	Arguments arguments;
+	arguments.invalid = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+
+		if (OptionResult result = parse_log_option(argc, argv, i, arguments.log_options); result != OptionResult::Unknown) {
+			if (result == OptionResult::Invalid) return arguments;
+		} else if (argument == "--headless") {
+			arguments.load_profile.clients = 0;
+		} else if (argument == "--loadgen" || argument == "--ramp" || argument == "--duration") {
+			int* value = argument == "--loadgen" ? &arguments.load_profile.clients : argument == "--ramp" ? &arguments.load_profile.ramp : &arguments.load_profile.duration;
+			std::optional<uint64_t> number = i + 1 < argc ? parse_unsigned(argv[++i]) : std::nullopt;
+			if (!number || *number < 1 || *number > INT32_MAX) {
+				LOGGER_ERROR("Specify a positive number with ", argument, " <number>");
+				return arguments;
+			}
+			*value = static_cast<int>(*number);
+		} else if (argument == "--behaviour") {
+			std::string behaviour = i + 1 < argc ? argv[++i] : "";
+			if (behaviour == "idle") {
+				arguments.load_profile.behaviour = LoadProfile::Behaviour::Idle;
+			} else if (behaviour == "random") {
+				arguments.load_profile.behaviour = LoadProfile::Behaviour::Random;
+			} else if (behaviour == "tracking") {
+				arguments.load_profile.behaviour = LoadProfile::Behaviour::Tracking;
+			} else {
+				LOGGER_ERROR("Specify the virtual client behaviour with --behaviour <idle|random|tracking>");
+				return arguments;
+			}
+		} else if (argument == "--bot") {
+			arguments.headless_input.source = HeadlessInput::Source::Bot;
+		} else if (argument == "--script") {
+			if (i + 1 < argc) {
+				arguments.headless_input.source = HeadlessInput::Source::Script;
+				arguments.headless_input.script_path = argv[++i];
+			} else {
+				LOGGER_ERROR("Specify an input script with --script <path>");
+				return arguments;
+			}
+		} else if (argument == "--frames") {
+			std::optional<uint64_t> frames = i + 1 < argc ? parse_unsigned(argv[++i]) : std::nullopt;
+			if (!frames) {
+				LOGGER_ERROR("Specify a valid frame count with --frames <count>");
+				return arguments;
+			}
+			arguments.headless_input.frames = *frames;
+		} else if (argument == "--fps") {
+			std::optional<uint64_t> fps = i + 1 < argc ? parse_unsigned(argv[++i]) : std::nullopt;
+			if (!fps || *fps < 1 || *fps > INT32_MAX) {
+				LOGGER_ERROR("Specify a valid frame rate with --fps <frames per second>");
+				return arguments;
+			}
+			arguments.frame_pacing.fps = static_cast<int>(*fps);
+			arguments.frame_pacing.mode = FramePacing::Mode::Capped;
+		} else if (argument == "--host") {
+			if (i + 1 < argc) {
+				arguments.host = argv[++i];
+			} else {
+				LOGGER_ERROR("Specify a valid IP address with --host <address>");
+				return arguments;
+			}
+		} else if (argument == "--port") {
+			std::optional<int> port = i + 1 < argc ? parse_port(argv[++i]) : std::nullopt;
+			if (!port) {
+				LOGGER_ERROR("Specify a valid port number with --port <1-65535>");
+				return arguments;
+			}
+			arguments.port = *port;
+		} else if (argument == "--help") {
+			std::cout <<
+				"usage: " << argv[0] << " [options]\n\n"
+				"options:\n"
+				"  --headless                    play one match without a window, logging frame stats <default>\n"
+				"  --loadgen <clients>           simulate this many clients against the coordinator\n"
+				"  --behaviour <idle|random|tracking>\n"
+				"                                [loadgen] how the virtual clients move <random>\n"
+				"  --ramp <clients per second>   [loadgen] how quickly clients are started <200>\n"
+				"  --duration <seconds>          [loadgen] stop and print a summary after this long\n"
+				"  --script <path>               [headless] play the \"<frame> <up|down|stop>\" lines in a file\n"
+				"  --bot                         [headless] follow the ball with the paddle\n"
+				"  --frames <count>              [headless] exit after this many frames\n"
+				"  --fps <frames per second>     [headless] frames sampled per second <60>\n"
+				"  --host <address>              address of the coordinator\n"
+				"  --port <1-65535>              port of the coordinator\n"
+				<< LOG_OPTIONS_HELP <<
+				"  --help                        show help\n";
+			return arguments;
+		}
+	}
+
+	arguments.invalid = false;
+	return arguments;
+}
+
+int main(int argc, char** argv) {
+	Arguments arguments = parse_arguments(argc, argv);
+
+	if (arguments.invalid || !apply_log_options(arguments.log_options)) {
+		return -1;
+	}
+
+	std::string address = arguments.host.value_or(MULTI_PONG_COORDINATOR_ADDRESS.first);
+	int port = arguments.port.value_or(MULTI_PONG_COORDINATOR_ADDRESS.second);
+
+	if (arguments.load_profile.clients > 0) {
+		LoadGenerator load_generator = LoadGenerator({ address, port }, arguments.load_profile);
+		return 0;
+	}
+
+	Client client = Client(address, port, std::make_unique<HeadlessRenderer>(arguments.frame_pacing, arguments.headless_input));
+	return 0;
+}
@@ -0,0 +1,369 @@
+#include "loadgen.h"
+#include "tools/logger.h"
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace multi_pong;
+
+static constexpr int64_t JOIN_RETRY_INTERVAL = 500000;  // microseconds
+static constexpr int GAME_SOCKET_BUFFER = 8 * 1024 * 1024;
+
+LoadGenerator::LoadGenerator(const std::pair<std::string, int>& coordinator, LoadProfile load_profile)
+    : coordinator_address(coordinator), profile(load_profile) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        LOGGER_ERROR("Failed to initialise Winsock");
+        return;
+    }
+#else
+    // every virtual client holds a descriptor, so take whatever the hard limit allows
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+
+    coordinator_server.sin_family = AF_INET;
+    coordinator_server.sin_port = htons(coordinator_address.second);
+    inet_pton(AF_INET, coordinator_address.first.c_str(), &coordinator_server.sin_addr);
+
+    game_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (game_socket < 0) {
+        LOGGER_ERROR("Failed to create game socket");
+        return;
+    }
+
+    // thousands of clients receive a state every tick, a small buffer would turn bursts into loss
+    int buffer_size = GAME_SOCKET_BUFFER;
+    setsockopt(game_socket, SOL_SOCKET, SO_RCVBUF, (const char*)&buffer_size, sizeof(buffer_size));
+    set_non_blocking(game_socket);
+
+    clients.resize(profile.clients);
+
+    LOGGER_INFO("Generating load from ", profile.clients, " clients against ", coordinator_address.first, ":", coordinator_address.second);
+    run();
+}
+
+LoadGenerator::~LoadGenerator() {
+    for (VirtualClient& client : clients) {
+        if (client.coordinator_socket >= 0) {
+            close_socket(client.coordinator_socket);
+        }
+    }
+    close_socket(game_socket);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void LoadGenerator::run() {
+    std::vector<pollfd> poll_fds;
+    std::vector<size_t> poll_clients;
+
+    int64_t started_at = now_microseconds();
+    int64_t next_report = started_at + 1000000;
+    int64_t last_report = started_at;
+    size_t started = 0;
+
+    while (!profile.duration || now_microseconds() - started_at < static_cast<int64_t>(profile.duration) * 1000000) {
+        int64_t now = now_microseconds();
+
+        // clients are ramped up so the coordinator's accept queue is not flooded all at once
+        size_t due = std::min(clients.size(), static_cast<size_t>((now - started_at) * std::max(profile.ramp, 1) / 1000000) + 1);
+        while (started < due) {
+            start_client(started++, now);
+        }
+
+        poll_fds.clear();
+        poll_clients.clear();
+        poll_fds.push_back({ game_socket, POLLIN, 0 });
+
+        for (size_t i = 0; i < started; i++) {
+            const VirtualClient& client = clients[i];
+            if (client.coordinator_socket < 0) continue;
+
+            poll_fds.push_back({ client.coordinator_socket, static_cast<short>(client.phase == Phase::Connecting ? POLLOUT : POLLIN), 0 });
+            poll_clients.push_back(i);
+        }
+
+        int ready = poll_sockets(poll_fds.data(), poll_fds.size(), 5);
+        now = now_microseconds();
+
+        if (ready > 0) {
+            if (poll_fds[0].revents & POLLIN) {
+                receive_states(now);
+            }
+
+            for (size_t i = 1; i < poll_fds.size(); i++) {
+                if (!poll_fds[i].revents) continue;
+
+                size_t index = poll_clients[i - 1];
+                if (clients[index].phase == Phase::Connecting) {
+                    handle_connected(index, now);
+                } else {
+                    receive_coordinator(index, now);
+                }
+            }
+        }
+
+        drive_inputs(now);
+
+        if (now >= next_report) {
+            report((now - last_report) / 1000000.0, false);
+            last_report = now;
+            next_report += 1000000;
+        }
+    }
+
+    report((now_microseconds() - started_at) / 1000000.0, true);
+}
+
+void LoadGenerator::start_client(size_t index, int64_t now) {
+    VirtualClient& client = clients[index];
+
+    client.coordinator_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (client.coordinator_socket < 0) {
+        fail_client(index, "failed to create coordinator socket");
+        return;
+    }
+
+    set_non_blocking(client.coordinator_socket);
+    client.phase = Phase::Connecting;
+    client.search_sent_at = now;
+
+    if (connect(client.coordinator_socket, (struct sockaddr*)&coordinator_server, sizeof(coordinator_server)) == 0) {
+        handle_connected(index, now);
+        return;
+    }
+
+#ifdef _WIN32
+    bool in_progress = WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    bool in_progress = errno == EINPROGRESS;
+#endif
+
+    if (!in_progress) {
+        fail_client(index, "failed to connect to the coordinator");
+    }
+}
+
+void LoadGenerator::fail_client(size_t index, const char* reason) {
+    VirtualClient& client = clients[index];
+
+    LOGGER_DEBUG("Virtual client ", index, " failed: ", reason);
+
+    if (client.coordinator_socket >= 0) {
+        close_socket(client.coordinator_socket);
+        client.coordinator_socket = -1;
+    }
+
+    if (!client.token.empty()) {
+        clients_by_token.erase(client.token);
+    }
+
+    client.phase = Phase::Failed;
+    interval.failures++;
+    total.failures++;
+}
+
+void LoadGenerator::handle_connected(size_t index, int64_t now) {
+    VirtualClient& client = clients[index];
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(client.coordinator_socket, SOL_SOCKET, SO_ERROR, (char*)&error, &length);
+
+    if (error != 0) {
+        fail_client(index, "failed to connect to the coordinator");
+        return;
+    }
+
+    // no latencies are reported, so the coordinator falls back to its own measurements
+    Message search_message = Message();
+    search_message.mutable_search()->CopyFrom(Search());
+    std::string serialised_message = search_message.SerializeAsString();
+
+    if (send(client.coordinator_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0) < 0) {
+        fail_client(index, "failed to send search");
+        return;
+    }
+
+    client.phase = Phase::Searching;
+    client.search_sent_at = now;
+}
+
+void LoadGenerator::receive_coordinator(size_t index, int64_t now) {
+    VirtualClient& client = clients[index];
+    char buffer[MULTI_PONG_SERVER_BUFFER];
+
+    int received = recv(client.coordinator_socket, buffer, sizeof(buffer), 0);
+
+    if (received <= 0) {
+        fail_client(index, "lost connection to the coordinator");
+        return;
+    }
+
+    Message message;
+    if (!message.ParseFromArray(buffer, received) || !message.has_match()) {
+        return;
+    }
+
+    if (client.phase != Phase::Searching) {
+        return;
+    }
+
+    const Match& match = message.match();
+    client.token = match.token();
+    client.identifier = match.player().identifier();
+    client.server_address.sin_family = AF_INET;
+    client.server_address.sin_port = htons(match.port());
+    inet_pton(AF_INET, match.host().c_str(), &client.server_address.sin_addr);
+    clients_by_token[client.token] = index;
+
+    interval.search_to_match.record(now - client.search_sent_at);
+    total.search_to_match.record(now - client.search_sent_at);
+    interval.matched++;
+    total.matched++;
+
+    client.phase = Phase::Joining;
+    send_join(client, now);
+}
+
+void LoadGenerator::send_join(VirtualClient& client, int64_t now) {
+    Message join_message;
+    join_message.mutable_join()->set_token(client.token);
+    send_to_server(client, join_message);
+    client.join_sent_at = now;
+}
+
+void LoadGenerator::send_to_server(const VirtualClient& client, const Message& message) {
+    std::string serialised_message = message.SerializeAsString();
+    sendto(game_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0, (struct sockaddr*)&client.server_address, sizeof(client.server_address));
+}
+
+void LoadGenerator::receive_states(int64_t now) {
+    char buffer[MULTI_PONG_SERVER_BUFFER];
+    Message message;
+
+    while (true) {
+        int received = recvfrom(game_socket, buffer, sizeof(buffer), 0, nullptr, nullptr);
+        if (received < 0) break;
+
+        if (!message.ParseFromArray(buffer, received) || !message.has_state()) continue;
+
+        const State& state = message.state();
+        auto it = clients_by_token.find(state.token());
+        if (it == clients_by_token.end()) continue;
+
+        VirtualClient& client = clients[it->second];
+        const Player& own_player = client.identifier == Player::PLAYER_1 ? state.player_1() : state.player_2();
+
+        if (client.phase == Phase::Joining) {
+            client.phase = Phase::Playing;
+            interval.join_latency.record(now - client.join_sent_at);
+            total.join_latency.record(now - client.join_sent_at);
+            interval.playing++;
+            total.playing++;
+        } else if (client.last_state_at) {
+            uint64_t deviation = static_cast<uint64_t>(std::llabs(now - client.last_state_at - MULTI_PONG_SERVER_UPDATE_RATE));
+            interval.jitter.record(deviation);
+            total.jitter.record(deviation);
+        }
+
+        if (state.frame() <= client.last_frame) {
+            interval.reordered++;
+            total.reordered++;
+            continue;
+        }
+
+        if (client.last_frame) {
+            interval.lost += state.frame() - client.last_frame - 1;
+            total.lost += state.frame() - client.last_frame - 1;
+        }
+
+        // the server can only acknowledge movements that were actually sent
+        if (own_player.identifier() != client.identifier || own_player.sequence() > client.sequence) {
+            interval.invalid++;
+            total.invalid++;
+        }
+
+        interval.states++;
+        total.states++;
+        client.last_frame = state.frame();
+        client.last_state_at = now;
+        client.ball_y = state.ball().y();
+        client.paddle_location = own_player.paddle_location();
+    }
+}
+
+void LoadGenerator::drive_inputs(int64_t now) {
+    std::uniform_int_distribution<int> direction_distribution(0, 2);
+    std::uniform_int_distribution<int64_t> interval_distribution(profile.move_interval * 500, profile.move_interval * 1500);
+
+    for (VirtualClient& client : clients) {
+        if (client.phase == Phase::Joining && now - client.join_sent_at >= JOIN_RETRY_INTERVAL) {
+            send_join(client, now);
+            continue;
+        }
+
+        if (client.phase != Phase::Playing || profile.behaviour == LoadProfile::Behaviour::Idle || now < client.next_move_at) {
+            continue;
+        }
+
+        client.next_move_at = now + interval_distribution(rng);
+
+        Direction direction = Direction::STOP;
+        if (profile.behaviour == LoadProfile::Behaviour::Random) {
+            direction = static_cast<Direction>(direction_distribution(rng));
+        } else {
+            float offset = client.ball_y - client.paddle_location;
+            if (offset < -MULTI_PONG_PADDLE_HEIGHT / 4.0f) {
+                direction = Direction::UP;
+            } else if (offset > MULTI_PONG_PADDLE_HEIGHT / 4.0f) {
+                direction = Direction::DOWN;
+            }
+        }
+
+        if (direction == client.direction) continue;
+        client.direction = direction;
+
+        Message movement_message;
+        Movement* movement = movement_message.mutable_movement();
+        movement->set_token(client.token);
+        movement->set_direction(direction);
+        movement->set_sequence(++client.sequence);
+        send_to_server(client, movement_message);
+    }
+}
+
+void LoadGenerator::report(double seconds, bool summary) {
+    Statistics& statistics = summary ? total : interval;
+
+    size_t playing = 0;
+    for (const VirtualClient& client : clients) {
+        playing += client.phase == Phase::Playing;
+    }
+
+    uint64_t expected = statistics.states + statistics.lost;
+    double loss = expected ? 100.0 * statistics.lost / expected : 0.0;
+
+    LOGGER_INFO(summary ? "Load summary: " : "Load: ", playing, "/", clients.size(), " playing, ",
+        statistics.playing / 2.0 / seconds, " matches started/s, ", statistics.failures, " failed, search to match p50 ",
+        statistics.search_to_match.percentile(50) / 1000.0, "ms p99 ", statistics.search_to_match.percentile(99) / 1000.0, "ms, join p50 ",
+        statistics.join_latency.percentile(50) / 1000.0, "ms p99 ", statistics.join_latency.percentile(99) / 1000.0, "ms, jitter p50 ",
+        statistics.jitter.percentile(50), "us p99 ", statistics.jitter.percentile(99), "us, ", statistics.states, " states, loss ",
+        loss, "%, ", statistics.reordered, " reordered, ", statistics.invalid, " invalid");
+
+    if (!summary) {
+        interval = Statistics();
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "tools/common.h"
+#include "tools/metrics.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <cstdint>
+
+
+struct LoadProfile {
+    enum class Behaviour {
+        Idle,  // never moves
+        Random,  // picks a random direction at every move interval
+        Tracking  // follows the ball with its own paddle
+    };
+
+    int clients = 0;
+    Behaviour behaviour = Behaviour::Random;
+    int ramp = 200;  // clients started per second
+    int duration = 0;  // seconds, zero runs until killed
+    int move_interval = 250;  // milliseconds between decisions
+};
+
+// runs many virtual clients from one thread - every client has its own coordinator connection but all
+// game traffic shares a single UDP socket, with incoming states routed to their client by token
+class LoadGenerator {
+    private:
+        enum class Phase {
+            Idle,
+            Connecting,
+            Searching,
+            Joining,
+            Playing,
+            Failed
+        };
+
+        struct VirtualClient {
+            Phase phase = Phase::Idle;
+            socket_t coordinator_socket = -1;
+            std::string token;
+            int identifier = 0;
+            sockaddr_in server_address{};
+            int64_t search_sent_at = 0;  // microseconds on the steady clock
+            int64_t join_sent_at = 0;
+            int64_t last_state_at = 0;
+            int64_t next_move_at = 0;
+            uint32_t last_frame = 0;
+            uint32_t sequence = 0;
+            multi_pong::Direction direction = multi_pong::Direction::STOP;
+            float ball_y = 0.5f;
+            float paddle_location = 0.5f;
+        };
+
+        // interval figures are reset after every report, totals are kept for the summary
+        struct Statistics {
+            Histogram search_to_match;  // microseconds
+            Histogram join_latency;  // join sent to first state, microseconds
+            Histogram jitter;  // deviation of state inter-arrival from the tick, microseconds
+            uint64_t matched = 0;
+            uint64_t playing = 0;
+            uint64_t states = 0;
+            uint64_t lost = 0;
+            uint64_t reordered = 0;
+            uint64_t invalid = 0;
+            uint64_t failures = 0;
+        };
+
+        std::pair<std::string, int> coordinator_address;
+        sockaddr_in coordinator_server{};
+        LoadProfile profile;
+        socket_t game_socket;
+        std::vector<VirtualClient> clients;
+        std::unordered_map<std::string, size_t> clients_by_token;
+        std::mt19937 rng{ std::random_device{}() };
+        Statistics interval;
+        Statistics total;
+
+        void run();
+        void start_client(size_t index, int64_t now);
+        void fail_client(size_t index, const char* reason);
+        void handle_connected(size_t index, int64_t now);
+        void receive_coordinator(size_t index, int64_t now);
+        void receive_states(int64_t now);
+        void send_join(VirtualClient& client, int64_t now);
+        void drive_inputs(int64_t now);
+        void report(double seconds, bool summary);
+        void send_to_server(const VirtualClient& client, const multi_pong::Message& message);
+
+    public:
+        LoadGenerator(const std::pair<std::string, int>& coordinator, LoadProfile load_profile);
+        ~LoadGenerator();
+};
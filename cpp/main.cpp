@@ -1,10 +1,13 @@
 #include "client.h"
-#include "coordinator.h"
-#include "server.h"
+#include "spectator.h"
+#include "loadgen.h"
 #include "tools/logger.h"
 #include "tools/common.h"
+#include "tools/options.h"
 #include "tools/renderer.h"
 #include "tools/renderer_opengl.h"
+#include "tools/renderer_wall.h"
+#include "tools/renderer_headless.h"
 
 #ifdef _WIN32
 #include "tools/renderer_directx11.h"
@@ -20,33 +23,18 @@
 struct Arguments {
 	bool invalid = false;
 	bool client = true;
-	bool server = false;
-	bool coordinator = false;
+	bool spectate = false;
+	LoadProfile load_profile;
 	bool directx_11 = false;
+	bool headless = false;
+	HeadlessInput headless_input;
+	FramePacing frame_pacing;
 	std::optional<int> port;
 	std::optional<std::string> host;
 	std::vector<std::pair<std::string, int>> server_addresses;
-	Logger::Level log_level = Logger::Level::Info;
+	LogOptions log_options;
 };
 
-static std::optional<std::pair<std::string, int>> parse_address(const std::string& address) {
-	auto colon = address.find(':');
-	if (colon == std::string::npos) return std::nullopt;
-
-	std::string host = address.substr(0, colon);
-	int port = 0;
-
-	try {
-		port = std::stoi(address.substr(colon + 1));
-		if (port < 1 || port > 65535) return std::nullopt;
-	}
-	catch (...) {
-		return std::nullopt;
-	}
-
-	return std::make_pair(host, port);
-}
-
 static Arguments parse_arguments(int argc, char** argv) {
 	Arguments arguments;
 
@@ -57,21 +45,92 @@ static Arguments parse_arguments(int argc, char** argv) {
 	for (int i = 1; i < argc; i++) {
 		std::string argument = argv[i];
 
-		if (argument == "--client") {
+		if (OptionResult result = parse_log_option(argc, argv, i, arguments.log_options); result != OptionResult::Unknown) {
+			if (result == OptionResult::Invalid) return arguments;
+		} else if (argument == "--client") {
 			arguments.client = true;
-		} else if (argument == "--server") {
-			arguments.server = true;
-		} else if (argument == "--coordinator") {
-			arguments.coordinator = true;
+		} else if (argument == "--spectate") {
+			arguments.spectate = true;
+		} else if (argument == "--loadgen" || argument == "--ramp" || argument == "--duration") {
+			int* value = argument == "--loadgen" ? &arguments.load_profile.clients : argument == "--ramp" ? &arguments.load_profile.ramp : &arguments.load_profile.duration;
+			try {
+				if (i + 1 >= argc || (*value = std::stoi(argv[++i])) < 1) {
+					LOGGER_ERROR("Specify a positive number with ", argument, " <number>");
+					return arguments;
+				}
+			} catch (...) {
+				LOGGER_ERROR("Specify a positive number with ", argument, " <number>");
+				return arguments;
+			}
+		} else if (argument == "--behaviour") {
+			std::string behaviour = i + 1 < argc ? argv[++i] : "";
+			if (behaviour == "idle") {
+				arguments.load_profile.behaviour = LoadProfile::Behaviour::Idle;
+			} else if (behaviour == "random") {
+				arguments.load_profile.behaviour = LoadProfile::Behaviour::Random;
+			} else if (behaviour == "tracking") {
+				arguments.load_profile.behaviour = LoadProfile::Behaviour::Tracking;
+			} else {
+				LOGGER_ERROR("Specify the virtual client behaviour with --behaviour <idle|random|tracking>");
+				return arguments;
+			}
 		} else if (argument == "--directx11" || argument == "--dx11") {
 			arguments.directx_11 = true;
-		} else if (argument == "--verbose") {
-			arguments.log_level = Logger::Level::Debug;
+		} else if (argument == "--headless") {
+			arguments.headless = true;
+		} else if (argument == "--bot") {
+			arguments.headless_input.source = HeadlessInput::Source::Bot;
+		} else if (argument == "--script") {
+			if (i + 1 < argc) {
+				arguments.headless_input.source = HeadlessInput::Source::Script;
+				arguments.headless_input.script_path = argv[++i];
+			} else {
+				LOGGER_ERROR("Specify an input script with --script <path>");
+				return arguments;
+			}
+		} else if (argument == "--frames") {
+			if (i + 1 < argc) {
+				try {
+					long long frames = std::stoll(argv[++i]);
+					if (frames < 0) {
+						LOGGER_ERROR("Specify a valid frame count with --frames <count>");
+						return arguments;
+					}
+					arguments.headless_input.frames = static_cast<uint64_t>(frames);
+				} catch (...) {
+					LOGGER_ERROR("Specify a valid frame count with --frames <count>");
+					return arguments;
+				}
+			} else {
+				LOGGER_ERROR("Specify a valid frame count with --frames <count>");
+				return arguments;
+			}
+		} else if (argument == "--vsync") {
+			arguments.frame_pacing.mode = FramePacing::Mode::VSync;
+		} else if (argument == "--on-demand") {
+			arguments.frame_pacing.mode = FramePacing::Mode::OnDemand;
+		} else if (argument == "--fps") {
+			if (i + 1 < argc) {
+				try {
+					arguments.frame_pacing.fps = std::stoi(argv[++i]);
+					arguments.frame_pacing.mode = FramePacing::Mode::Capped;
+					if (arguments.frame_pacing.fps < 1) {
+						LOGGER_ERROR("Specify a valid frame rate with --fps <frames per second>");
+						return arguments;
+					}
+				} catch (...) {
+					LOGGER_ERROR("Specify a valid frame rate with --fps <frames per second>");
+					return arguments;
+				}
+			} else {
+				LOGGER_ERROR("Specify a valid frame rate with --fps <frames per second>");
+				return arguments;
+			}
 		} else if (argument == "--host") {
 			if (i + 1 < argc) {
 				arguments.host = argv[++i];
 			} else {
-				Logger::error("Specify a valid IP address with --host <address>");
+				LOGGER_ERROR("Specify a valid IP address with --host <address>");
 				return arguments;
 			}
 		} else if (argument == "--port") {
@@ -79,27 +138,27 @@ static Arguments parse_arguments(int argc, char** argv) {
 				try {
 					arguments.port = std::stoi(argv[++i]);
 					if (arguments.port < 1 || arguments.port > 65535) {
-						Logger::error("Specify a valid port number with --port <1-65535>");
+						LOGGER_ERROR("Specify a valid port number with --port <1-65535>");
 						return arguments;
 					}
 				} catch (...) {
-					Logger::error("Specify a valid port number with --port <1-65535>");
+					LOGGER_ERROR("Specify a valid port number with --port <1-65535>");
 					return arguments;
 				}
 			} else {
-				Logger::error("Specify a valid port number with --port <1-65535>");
+				LOGGER_ERROR("Specify a valid port number with --port <1-65535>");
 				return arguments;
 			}
 		} else if (argument == "--server-address") {
 			if (i + 1 < argc) {
-				if (auto address = parse_address(argv[++i])) {
-					arguments.server_addresses.push_back(*address);
+				if (auto addresses = parse_address_range(argv[++i])) {
+					arguments.server_addresses.insert(arguments.server_addresses.end(), addresses->begin(), addresses->end());
 				} else {
-					Logger::error("Invalid server address: ", argv[i - 1]);
+					LOGGER_ERROR("Invalid server address: ", argv[i - 1]);
 					return arguments;
 				}
 			} else {
-				Logger::error("Specify multiple server addresses with --server-address <address:port>");
+				LOGGER_ERROR("Specify multiple server addresses with --server-address <address:port>");
 				return arguments;
 			}
 		} else if (argument == "--help") {
@@ -107,16 +166,27 @@ static Arguments parse_arguments(int argc, char** argv) {
 				"usage: " << argv[0] << " [options]\n\n"
 				"options:\n"
 				"  --client                      <default>\n"
-				"  --server                      run server\n"
-				"  --coordinator                 run coordinator\n"
+				"  --spectate                    watch every --server-address on one wall\n"
+				"  --loadgen <clients>           simulate this many clients against the coordinator\n"
+				"  --behaviour <idle|random|tracking>\n"
+				"                                [loadgen] how the virtual clients move <random>\n"
+				"  --ramp <clients per second>   [loadgen] how quickly clients are started <200>\n"
+				"  --duration <seconds>          [loadgen] stop and print a summary after this long\n"
 #ifdef _WIN32
 				"  --directx11, --dx11           [client] use the directx 11 renderer\n"
 #endif
-				"  --host <address>              [client] address of the coordinator\n"
-				"  --port <1-65535>              [client] port of the coordinator\n"
-				"                                [server/coordinator] port to listen on\n"
-				"  --server-address <host:port>  [coordinator] (multiple) game server endpoints\n"
-				"  --verbose                     enable debug logging\n"
+				"  --headless                    [client] run without a window, logging frame stats\n"
+				"  --script <path>               [headless] play the \"<frame> <up|down|stop>\" lines in a file\n"
+				"  --bot                         [headless] follow the ball with the paddle\n"
+				"  --frames <count>              [headless] exit after this many frames\n"
+				"  --vsync                       [client] present once per display refresh <default>\n"
+				"  --fps <frames per second>     [client] cap the frame rate instead of using vsync\n"
+				"  --on-demand                   [client] only redraw when a new state or input arrives\n"
+				"  --host <address>              [client/loadgen] address of the coordinator\n"
+				"  --port <1-65535>              [client/loadgen] port of the coordinator\n"
+				"  --server-address <host:port>  [spectate] (multiple) game server endpoints,\n"
+				"                                host:first-last for a range of ports\n"
+				<< LOG_OPTIONS_HELP <<
 				"  --help                        show help\n";
 			return arguments;
 		}
@@ -129,27 +199,25 @@ static Arguments parse_arguments(int argc, char** argv) {
 int main(int argc, char** argv) {
 	Arguments arguments = parse_arguments(argc, argv);
 
-	Logger::level = arguments.log_level;
-
-	if (arguments.invalid) {
+	if (arguments.invalid || !apply_log_options(arguments.log_options)) {
 		return -1;
 	}
 
-	if (arguments.server && arguments.coordinator) {
-		Logger::warning("Both --server and --coordinator specified - running the server");
-	}
-
-	if (arguments.server) {
-		int port = arguments.port.value_or(MULTI_PONG_SERVER_PORT);
+	if (arguments.load_profile.clients > 0) {
+		std::string address = arguments.host.value_or(MULTI_PONG_COORDINATOR_ADDRESS.first);
+		int port = arguments.port.value_or(MULTI_PONG_COORDINATOR_ADDRESS.second);
 
-		Server server = Server(port);
+		LoadGenerator load_generator = LoadGenerator({ address, port }, arguments.load_profile);
 		return 0;
 	}
 
-	if (arguments.coordinator) {
-		int port = arguments.port.value_or(MULTI_PONG_COORDINATOR_PORT);
+	if (arguments.spectate) {
+		if (arguments.server_addresses.empty()) {
+			LOGGER_ERROR("Specify the servers to watch with --server-address <host:port>");
+			return -1;
+		}
 
-		Coordinator coordinator = Coordinator(port, arguments.server_addresses);
+		Spectator spectator = Spectator(arguments.server_addresses, std::make_unique<WallRenderer>(arguments.frame_pacing));
 		return 0;
 	}
 
@@ -159,17 +227,22 @@ int main(int argc, char** argv) {
 
 		std::unique_ptr<Renderer> renderer;
 
+		if (arguments.headless) {
+			Client client = Client(address, port, std::make_unique<HeadlessRenderer>(arguments.frame_pacing, arguments.headless_input));
+			return 0;
+		}
+
 #ifdef _WIN32
 		if (arguments.directx_11) {
 			renderer = std::make_unique<DirectX11Renderer>();
 		} else {
-			renderer = std::make_unique<OpenGLRenderer>();
+			renderer = std::make_unique<OpenGLRenderer>(arguments.frame_pacing);
 		}
 #else
 		if (arguments.directx_11) {
-			Logger::warning("DirectX 11 is not supported on this platform - falling back to the OpenGL renderer");
+			LOGGER_WARNING("DirectX 11 is not supported on this platform - falling back to the OpenGL renderer");
 		}
-		renderer = std::make_unique<OpenGLRenderer>();
+		renderer = std::make_unique<OpenGLRenderer>(arguments.frame_pacing);
 #endif
 
 		Client client = Client(address, port, std::move(renderer));
@@ -0,0 +1,131 @@
+#include "rollback.h"
+#include "tools/logger.h"
+
+using namespace multi_pong;
+
+RollbackSession::RollbackSession(uint64_t seed, int local_player)
+    : local(local_player), remote(1 - local_player), simulation(Simulation::Mode::Fixed, seed), history(MULTI_PONG_ROLLBACK_HISTORY) {
+    for (int i = 0; i < 2; i++) {
+        players[i].set_identifier(i == 0 ? Player::PLAYER_1 : Player::PLAYER_2);
+        players[i].set_paddle_direction(Direction::STOP);
+        players[i].set_paddle_location(0.5f);
+        players[i].set_score(0);
+    }
+
+    state.set_frame(0);
+    simulation.reset_ball(state);
+}
+
+Direction RollbackSession::remote_input(uint32_t at) const {
+    if (at < remote_frames) {
+        return remote_inputs[at % MULTI_PONG_ROLLBACK_HISTORY];
+    }
+    return remote_frames ? remote_inputs[(remote_frames - 1) % MULTI_PONG_ROLLBACK_HISTORY] : Direction::STOP;
+}
+
+// the local input is already in the record, the remote one is whatever is known or predicted right now -
+// the world is saved again on every pass, since a later rollback may land on a frame that was simulated again
+void RollbackSession::simulate(Frame& record) {
+    record.simulation = simulation;
+    record.state.CopyFrom(state);
+    record.players[0].CopyFrom(players[0]);
+    record.players[1].CopyFrom(players[1]);
+    record.inputs[remote] = remote_input(frame);
+    players[0].set_paddle_direction(record.inputs[0]);
+    players[1].set_paddle_direction(record.inputs[1]);
+
+    simulation.step(state, players[0], players[1]);
+    record.checksum = state.checksum();
+    frame++;
+}
+
+bool RollbackSession::advance() {
+    if (frame >= remote_frames + MULTI_PONG_ROLLBACK_WINDOW || frame >= acknowledged + MULTI_PONG_ROLLBACK_HISTORY) {
+        return false;
+    }
+
+    Frame& record = history[frame % MULTI_PONG_ROLLBACK_HISTORY];
+    record.inputs[local] = local_direction;
+
+    simulate(record);
+    return true;
+}
+
+void RollbackSession::roll_back(uint32_t to) {
+    uint32_t newest = frame;
+    const Frame& restored = history[to % MULTI_PONG_ROLLBACK_HISTORY];
+
+    simulation = restored.simulation;
+    state.CopyFrom(restored.state);
+    players[0].CopyFrom(restored.players[0]);
+    players[1].CopyFrom(restored.players[1]);
+    frame = to;
+
+    while (frame < newest) {
+        simulate(history[frame % MULTI_PONG_ROLLBACK_HISTORY]);
+    }
+
+    rollbacks++;
+    resimulated_frames += newest - to;
+    LOGGER_DEBUG("Rolled back ", newest - to, " frames to frame ", to);
+}
+
+// only inputs that continue the ones already received are taken, the peer resends everything from our
+// acknowledgement on so a gap is always filled by a later datagram
+void RollbackSession::receive(const InputWindow& window) {
+    acknowledged = std::max(acknowledged, std::min(window.acknowledged, frame));
+
+    uint32_t mispredicted = frame;
+
+    for (uint32_t i = 0; i < window.count; i++) {
+        uint32_t at = window.frame + i;
+
+        if (at < remote_frames) continue;
+        if (at > remote_frames || at >= frame + MULTI_PONG_ROLLBACK_WINDOW) break;
+
+        remote_inputs[at % MULTI_PONG_ROLLBACK_HISTORY] = window.directions[i];
+        remote_frames++;
+
+        if (at < frame && history[at % MULTI_PONG_ROLLBACK_HISTORY].inputs[remote] != window.directions[i]) {
+            mispredicted = std::min(mispredicted, at);
+        }
+    }
+
+    if (mispredicted < frame) {
+        roll_back(mispredicted);
+    }
+}
+
+void RollbackSession::fill_input(Input& input) const {
+    uint32_t end = std::min(frame, acknowledged + MULTI_PONG_ROLLBACK_INPUTS);
+
+    input.set_frame(acknowledged);
+    input.clear_directions();
+    for (uint32_t at = acknowledged; at < end; at++) {
+        input.add_directions(history[at % MULTI_PONG_ROLLBACK_HISTORY].inputs[local]);
+    }
+    input.set_acknowledged(remote_frames);
+
+    // frames with both inputs known will never be simulated again, the newest whole interval among them is
+    // reported for the server to compare
+    uint32_t settled = std::min(frame, remote_frames);
+    uint32_t checksum_frame = settled - settled % MULTI_PONG_ROLLBACK_CHECKSUM_INTERVAL;
+
+    if (checksum_frame > 0) {
+        input.set_checksum_frame(checksum_frame);
+        input.set_checksum(history[(checksum_frame - 1) % MULTI_PONG_ROLLBACK_HISTORY].checksum);
+    } else {
+        input.clear_checksum_frame();
+        input.clear_checksum();
+    }
+}
+
+void RollbackSession::fill_state(State& render_state) const {
+    render_state.set_frame(state.frame());
+    render_state.mutable_ball()->set_x(state.ball().x());
+    render_state.mutable_ball()->set_y(state.ball().y());
+    render_state.mutable_player_1()->set_paddle_location(players[0].paddle_location());
+    render_state.mutable_player_2()->set_paddle_location(players[1].paddle_location());
+    render_state.mutable_player_1()->set_score(players[0].score());
+    render_state.mutable_player_2()->set_score(players[1].score());
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "simulation.h"
+#include "tools/common.h"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+
+// the newest inputs relayed from the peer, handed from the network thread to the render thread
+struct InputWindow {
+    uint32_t frame = 0;  // of the first direction
+    uint32_t count = 0;
+    uint32_t acknowledged = 0;  // frames of our input the peer had received
+    multi_pong::Direction directions[MULTI_PONG_ROLLBACK_INPUTS] = {};
+};
+
+inline void read_input_window(const multi_pong::Input& input, InputWindow& window) {
+    window.frame = input.frame();
+    window.count = std::min(static_cast<uint32_t>(input.directions_size()), MULTI_PONG_ROLLBACK_INPUTS);
+    window.acknowledged = input.acknowledged();
+
+    for (uint32_t i = 0; i < window.count; i++) {
+        window.directions[i] = input.directions(static_cast<int>(i));
+    }
+}
+
+// both players run the whole match in fixed point from the same seed and exchange nothing but their inputs -
+// the peer is predicted to keep its last known direction, and when its real input turns out different the
+// session goes back to the frame it changed on and simulates forward again
+class RollbackSession {
+    private:
+        // the world before a frame was simulated and the inputs it was simulated with
+        struct Frame {
+            Simulation simulation;
+            multi_pong::State state;
+            multi_pong::Player players[2];
+            multi_pong::Direction inputs[2] = { multi_pong::Direction::STOP, multi_pong::Direction::STOP };
+            uint32_t checksum = 0;  // after the frame
+        };
+
+        int local;
+        int remote;
+        Simulation simulation;
+        multi_pong::State state;
+        multi_pong::Player players[2];
+
+        std::vector<Frame> history;  // by frame modulo MULTI_PONG_ROLLBACK_HISTORY
+        std::array<multi_pong::Direction, MULTI_PONG_ROLLBACK_HISTORY> remote_inputs{};
+        multi_pong::Direction local_direction = multi_pong::Direction::STOP;
+
+        uint32_t frame = 0;  // frames simulated so far
+        uint32_t remote_frames = 0;  // frames of the peer's input received, always consecutive from the first
+        uint32_t acknowledged = 0;  // frames of our input the peer has received
+        uint64_t rollbacks = 0;
+        uint64_t resimulated_frames = 0;
+
+        multi_pong::Direction remote_input(uint32_t at) const;
+        void simulate(Frame& record);
+        void roll_back(uint32_t to);
+
+    public:
+        RollbackSession(uint64_t seed, int local_player);
+
+        void set_local_direction(multi_pong::Direction direction) { local_direction = direction; }
+
+        // simulates the next frame, unless that would run too far ahead of the peer or past the inputs it
+        // has yet to acknowledge - the caller waits then rather than catching up in a burst later
+        bool advance();
+
+        void receive(const InputWindow& window);
+        void fill_input(multi_pong::Input& input) const;
+        void fill_state(multi_pong::State& render_state) const;
+
+        uint32_t get_frame() const { return frame; }
+        uint64_t get_rollbacks() const { return rollbacks; }
+        uint64_t get_resimulated_frames() const { return resimulated_frames; }
+};
@@ -1,18 +1,20 @@
 #include "server.h"
 #include "tools/logger.h"
+#include "tools/trace.h"
 
 #include <thread>
-#include <cstdlib>
 #include <string>
 #include <random>
+#include <algorithm>
 
 using namespace multi_pong;
 
-Server::Server(int server_port) : port(server_port) {
+Server::Server(int server_port, const std::pair<std::string, int>& coordinator, const ServerOptions& options)
+    : port(server_port), simulation(options.mode, options.seed), client_bandwidth(options.client_bandwidth), rollback(options.rollback) {
 #ifdef _WIN32
     WSADATA wsa_data;
     if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
-        Logger::error("Failed to initialise Winsock");
+        LOGGER_ERROR("Failed to initialise Winsock");
         return;
     }
 #endif
@@ -28,7 +30,7 @@ Server::Server(int server_port) : port(server_port) {
 
     server_socket = socket(AF_INET, SOCK_DGRAM, 0);
     if (server_socket < 0) {
-        Logger::error("Failed to create socket");
+        LOGGER_ERROR("Failed to create socket");
         return;
     }
 
@@ -39,11 +41,26 @@ Server::Server(int server_port) : port(server_port) {
     addr.sin_port = htons(port);
 
     if (bind(server_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        Logger::error("Failed to bind socket to port ", port);
+        LOGGER_ERROR("Failed to bind socket to port ", port);
         return;
     }
 
-    Logger::info("Socket bound successfully to port ", port);
+    LOGGER_INFO("Socket bound successfully to port ", port);
+
+    coordinator_address.sin_family = AF_INET;
+    coordinator_address.sin_port = htons(coordinator.second);
+    inet_pton(AF_INET, coordinator.first.c_str(), &coordinator_address.sin_addr);
+
+    // the receive timeout bounds how late a heartbeat or a retransmission can be when no packets arrive
+#ifdef _WIN32
+    DWORD timeout = MULTI_PONG_TIMER_RESOLUTION;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = MULTI_PONG_TIMER_RESOLUTION / 1000;
+    timeout.tv_usec = (MULTI_PONG_TIMER_RESOLUTION % 1000) * 1000;
+#endif
+    setsockopt(server_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
     listen();
 }
 
@@ -79,72 +96,199 @@ Tokens Server::generate_tokens() {
         tokens.set_token_2(generate_random_sequence());
     }
 
-    Logger::info("Generated tokens ", tokens.token_1(), " / ", tokens.token_2());
+    LOGGER_INFO("Generated tokens ", tokens.token_1(), " / ", tokens.token_2());
     return tokens;
 }
 
 void Server::listen() {
-    Logger::info("Started listening on 0.0.0.0:", port);
+    LOGGER_INFO("Started listening on 0.0.0.0:", port);
 
     Message message;
     sockaddr_in address{};
     socklen_t address_length = sizeof(address);
     char buffer[MULTI_PONG_SERVER_BUFFER];
 
+    send_heartbeat();
+
     while (true) {
         int received_data = recvfrom(server_socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&address, &address_length);
 
-        if (received_data < 0) {
-            continue;
+        if (received_data >= 0 && message.ParseFromArray(buffer, static_cast<int>(received_data))) {
+            LOGGER_DEBUG("Message parsed successfully, type: ", message.content_case());
+            receive_message(message, address);
         }
 
-        if (!message.ParseFromArray(buffer, static_cast<int>(received_data))) continue;
-        
-        Logger::debug("Message parsed successfully, type: ", message.content_case());
-        
-        switch (message.content_case()) {
-            case Message::kPrepare:
-                handle_prepare(message.prepare(), address);
-                break;
-            case Message::kJoin:
-                handle_join(message.join(), address);
-                break;
-            case Message::kMovement:
-                handle_movement(message.movement(), address);
-                break;
-            case Message::kQuery:
-                handle_query(address);
-                break;
-            default:
-                break;
+        auto now = std::chrono::steady_clock::now();
+
+        if (now >= next_heartbeat) {
+            send_heartbeat();
+        }
+
+        if (status.phase() == Status::PREPARING && now >= prepare_expires_at) {
+            expire_preparation();
         }
+
+        flush_reliable_peers(now);
     }
 }
 
+void Server::receive_message(const Message& message, const sockaddr_in& address) {
+    if (!message.has_reliable()) {
+        handle_message(message, address);
+        return;
+    }
+
+    auto it = reliable_peers.find(address_key(address));
+
+    if (it == reliable_peers.end()) {
+        if (!accepts_reliable_peer(message, address)) {
+            handle_message(message, address);
+            return;
+        }
+        it = reliable_peers.emplace(address_key(address), ReliablePeer{ address, ReliableChannel() }).first;
+    }
+
+    ReliablePeer& peer = it->second;
+
+    delivered_messages.clear();
+    if (peer.channel.receive(message, std::chrono::steady_clock::now(), delivered_messages) != ReliableChannel::Receipt::Delivered) {
+        return;
+    }
+
+    for (const Message& delivered : delivered_messages) {
+        handle_message(delivered, address);
+    }
+}
+
+void Server::handle_message(const Message& message, const sockaddr_in& address) {
+    switch (message.content_case()) {
+        case Message::kPrepare:
+            handle_prepare(message.prepare(), address);
+            break;
+        case Message::kJoin:
+            handle_join(message.join(), address);
+            break;
+        case Message::kMovement:
+            handle_movement(message.movement());
+            break;
+        case Message::kQuery:
+            handle_query(address);
+            break;
+        case Message::kSpectate:
+            handle_spectate(address);
+            break;
+        case Message::kPing:
+            handle_ping(message.ping(), address);
+            break;
+        case Message::kInput:
+            handle_input(message.input());
+            break;
+        default:
+            break;
+    }
+}
+
+// a channel is only opened for the coordinator and for players joining with a token this server handed out,
+// so arbitrary senders cannot grow the map - anyone else is handled as if the message were unreliable
+bool Server::accepts_reliable_peer(const Message& message, const sockaddr_in& address) {
+    switch (message.content_case()) {
+        case Message::kPrepare:
+            return secret.empty() || message.prepare().secret() == secret;
+        case Message::kJoin:
+            return get_player_id_by_token(message.join().token()).has_value();
+        default:
+            return address_key(address) == address_key(coordinator_address);
+    }
+}
+
+void Server::flush_reliable_peers(std::chrono::steady_clock::time_point now) {
+    for (auto it = reliable_peers.begin(); it != reliable_peers.end();) {
+        ReliablePeer& peer = it->second;
+        bool delivering = peer.channel.flush(now, [&](const Message& message) { send_message(message, peer.address); });
+
+        if (!delivering) {
+            LOGGER_WARNING("Gave up on control messages to ", address_string(peer.address), ":", ntohs(peer.address.sin_port), " after ", MULTI_PONG_RELIABLE_ATTEMPTS, " attempts");
+        }
+
+        // players keep theirs until the tokens are replaced, the rollback seed may still have to reach them
+        if (player_address_keys.count(it->first) == 0 && peer.channel.is_idle(now)) {
+            it = reliable_peers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void Server::send_heartbeat() {
+    Heartbeat heartbeat;
+    heartbeat.set_port(port);
+    heartbeat.set_phase(status.phase());
+    heartbeat.set_capacity(status.phase() == Status::WAITING ? 1 : 0);
+    heartbeat.set_load(load);
+
+    send(heartbeat, coordinator_address);
+    next_heartbeat = std::chrono::steady_clock::now() + std::chrono::milliseconds(MULTI_PONG_HEARTBEAT_INTERVAL);
+}
+
 void Server::handle_query(const sockaddr_in& address) {
     send(status, address);
 }
 
 void Server::handle_prepare(const Prepare& prepare, const sockaddr_in& address) {
-    Logger::info("Received preparation request from ", address_string(address), ":", ntohs(address.sin_port));
+    LOGGER_INFO("Received preparation request from ", address_string(address), ":", ntohs(address.sin_port));
+
+    // a pooled server is prepared again now and then to show the coordinator still holds its tokens, which
+    // keeps them from expiring as long as no player has joined yet
+    bool refreshing = status.phase() == Status::PREPARING && clients.empty();
 
-    if (status.phase() != Status::WAITING) {
+    if (status.phase() != Status::WAITING && !refreshing) {
         return;
     }
 
     if (secret == "") {
-        Logger::warning("No secret set - skipping authentication with ", address_string(address), ":", ntohs(address.sin_port));
+        LOGGER_WARNING("No secret set - skipping authentication with ", address_string(address), ":", ntohs(address.sin_port));
     } else if (secret != prepare.secret()) {
         return;
     }
 
-    Logger::info("Forwarding tokens after transitioning into a prepared state");
+    prepare_expires_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(MULTI_PONG_PREPARE_EXPIRY);
+
+    if (refreshing) {
+        send(tokens, address, true);
+        return;
+    }
+
+    LOGGER_INFO("Forwarding tokens after transitioning into a prepared state");
     status.set_phase(Status::PREPARING);
-    send(tokens, address);
+    send(tokens, address, true);
+    send_heartbeat();
+}
+
+// a player that never joins would otherwise hold the server in preparation for good - the tokens handed
+// out for it are replaced and the next heartbeat offers the server to the coordinator again
+void Server::expire_preparation() {
+    LOGGER_WARNING("Released prepared tokens after ", clients.size(), "/2 players joined within ", MULTI_PONG_PREPARE_EXPIRY / 1000, "s");
+
+    for (uint64_t key : player_address_keys) {
+        reliable_peers.erase(key);
+    }
+
+    tokens = generate_tokens();
+    clients.clear();
+    token_addresses.clear();
+    player_address_keys.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        connections.clear();
+    }
+
+    status.set_phase(Status::WAITING);
+    send_heartbeat();
 }
 
 void Server::handle_join(const Join& join, const sockaddr_in& address) {
-    Logger::info("Received join request from client ", address_string(address), ":", ntohs(address.sin_port));
+    LOGGER_INFO("Received join request from client ", address_string(address), ":", ntohs(address.sin_port));
 
     if (status.phase() != Status::PREPARING) {
         return;
@@ -163,17 +307,28 @@ void Server::handle_join(const Join& join, const sockaddr_in& address) {
     player.set_paddle_location(0.5f);
     player.set_score(0);
 
+    auto previous = token_addresses.find(token);
+    if (previous != token_addresses.end()) {
+        player_address_keys.erase(address_key(previous->second));
+    }
+
     token_addresses[token] = address;
+    player_address_keys.insert(address_key(address));
+
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        connections[token].snapshot_rate.set_bandwidth(client_bandwidth);
+    }
 
-    Logger::info("Registered client ", address_string(address), ":", ntohs(address.sin_port), " as player ", static_cast<int>(*player_id));
+    LOGGER_INFO("Registered client ", address_string(address), ":", ntohs(address.sin_port), " as player ", static_cast<int>(*player_id));
 
     if (clients.size() >= 2) {
         start_match();
     }
 }
 
-void Server::handle_movement(const Movement& movement, const sockaddr_in& address) {
-    if (status.phase() != Status::STARTED) {
+void Server::handle_movement(const Movement& movement) {
+    if (status.phase() != Status::STARTED || rollback) {
         return;
     }
 
@@ -182,83 +337,235 @@ void Server::handle_movement(const Movement& movement, const sockaddr_in& addres
         return;
     }
 
-    clients[movement.token()].set_paddle_direction(movement.direction());
-    Logger::debug("Player ", static_cast<int>(*player_id), " sent movement direction ", movement.direction());
+    PendingMovement* pending = pending_movements.reserve();
+    if (!pending) {
+        LOGGER_DEBUG("Dropped a movement from player ", static_cast<int>(*player_id), " - the game thread is behind");
+        return;
+    }
+
+    pending->player = *player_id;
+    pending->direction = movement.direction();
+    pending->has_sequence = movement.has_sequence();
+    pending->sequence = movement.sequence();
+    pending->history_size = std::min(movement.history_size(), MULTI_PONG_MOVEMENT_HISTORY);
+    std::copy_n(movement.history().begin(), pending->history_size, pending->history.begin());
+    pending_movements.commit();
+
+    LOGGER_DEBUG("Player ", static_cast<int>(*player_id), " sent movement direction ", movement.direction());
 }
 
-std::string Server::get_token_by_player_id(const Player::Identifier& player_id) {
-    for (const auto& [token, player] : clients) {
-        if (player.identifier() == player_id) {
-            return token;
+void Server::apply_movements() {
+    while (PendingMovement* movement = pending_movements.front()) {
+        Player& player = clients[movement->player == Player::PLAYER_1 ? tokens.token_1() : tokens.token_2()];
+
+        // datagrams can be reordered, an older movement must not undo a newer one
+        if (!movement->has_sequence || !player.has_sequence() || movement->sequence > player.sequence()) {
+            if (movement->has_sequence) {
+                replay_missed_inputs(player, *movement);
+                player.set_sequence(movement->sequence);
+                player.set_sequence_frame(state.frame());
+            }
+
+            player.set_paddle_direction(movement->direction);
+            TRACE_MARK(ServerApplied, movement->player, movement->sequence);
+        }
+
+        pending_movements.pop_front();
+    }
+}
+
+static int direction_sign(Direction direction) {
+    return direction == Direction::UP ? -1 : direction == Direction::DOWN ? 1 : 0;
+}
+
+// inputs between the last applied movement and this one were lost - those still carried in its history are
+// replayed over the ticks they covered, in place of the direction the paddle actually kept moving in
+void Server::replay_missed_inputs(Player& player, const PendingMovement& movement) {
+    uint32_t missed = movement.sequence - player.sequence() - 1;
+    uint32_t elapsed = state.frame() - player.sequence_frame();  // ticks simulated since the last applied input
+
+    int available = std::min(static_cast<int>(missed), movement.history_size);
+    int32_t correction = 0;  // paddle steps
+    uint32_t newer_ticks = 0;
+
+    for (int i = 0; i < available; i++) {
+        uint32_t entry = movement.history[i];
+        uint32_t ticks = entry >> 2;
+        int direction = static_cast<int>(entry & 3);
+
+        if (!Direction_IsValid(direction) || ticks < newer_ticks) {
+            return;
+        }
+
+        uint32_t covered = std::min(ticks, elapsed) - std::min(newer_ticks, elapsed);
+        correction += static_cast<int32_t>(covered) * (direction_sign(static_cast<Direction>(direction)) - direction_sign(player.paddle_direction()));
+        newer_ticks = ticks;
+    }
+
+    if (available > 0) {
+        simulation.shift_paddle(player, correction);
+        LOGGER_DEBUG("Replayed ", available, " of ", missed, " lost movements for player ", static_cast<int>(player.identifier()));
+    }
+}
+
+void Server::handle_spectate(const sockaddr_in& address) {
+    auto expires_at = std::chrono::steady_clock::now() + std::chrono::milliseconds(MULTI_PONG_SPECTATE_EXPIRY);
+    std::lock_guard<std::mutex> lock(spectators_mutex);
+
+    for (Spectator& spectator : spectators) {
+        if (address_key(spectator.address) == address_key(address)) {
+            spectator.expires_at = expires_at;
+            return;
         }
     }
-    return "";
+
+    if (spectators.size() >= MULTI_PONG_MAX_SPECTATORS) {
+        LOGGER_WARNING("Rejected spectator ", address_string(address), ":", ntohs(address.sin_port), " - already at ", MULTI_PONG_MAX_SPECTATORS);
+        return;
+    }
+
+    spectators.push_back({ address, expires_at });
+    LOGGER_INFO("Added spectator ", address_string(address), ":", ntohs(address.sin_port));
 }
 
 std::optional<Player::Identifier> Server::get_player_id_by_token(const std::string& token) {
+    return get_player_id_by_token(tokens, token);
+}
+
+std::optional<Player::Identifier> Server::get_player_id_by_token(const Tokens& tokens, const std::string& token) {
     if (token != tokens.token_1() && token != tokens.token_2())
         return std::nullopt;
 
     return (token == tokens.token_1()) ? Player::PLAYER_1 : Player::PLAYER_2;
 }
 
+void Server::handle_ping(const Ping& ping, const sockaddr_in& address) {
+    auto player_id = get_player_id_by_token(ping.token());
+    if (!player_id) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    Connection& connection = connections[ping.token()];
+    connection.pings_received++;
+
+    Pong pong;
+    pong.set_sequence(ping.sequence());
+    pong.set_sent_at(ping.sent_at());
+    pong.set_received(connection.pings_received);
+    send(pong, address);
+
+    if (ping.has_rtt()) {
+        connection.report.CopyFrom(ping);
+        LOGGER_INFO("Player ", static_cast<int>(*player_id), " reports rtt ", ping.rtt() / 1000.0f, "ms, jitter ", ping.jitter() / 1000.0f, "ms, loss ", ping.upstream_loss() * 100.0f, "% up ", ping.downstream_loss() * 100.0f, "% down");
+    }
+
+    if (ping.has_state_frame()) {
+        SnapshotRate& snapshot_rate = connection.snapshot_rate;
+        float previous_rate = snapshot_rate.get_rate();
+        SnapshotRate::Verdict verdict = snapshot_rate.report(ping.states_received(), ping.state_frame(), ping.recent_rtt());
+
+        if (verdict == SnapshotRate::Verdict::Decreased && snapshot_rate.get_rate() < previous_rate) {
+            LOGGER_INFO("Player ", static_cast<int>(*player_id), " snapshot rate down to ", snapshot_rate.get_rate(), "/s - loss ", snapshot_rate.get_loss() * 100.0f, "%, queueing ", snapshot_rate.get_queueing() / 1000.0f, "ms");
+        } else if (verdict == SnapshotRate::Verdict::Increased && previous_rate < SnapshotRate::MAX_RATE && snapshot_rate.get_rate() >= SnapshotRate::MAX_RATE) {
+            LOGGER_INFO("Player ", static_cast<int>(*player_id), " snapshot rate back to every tick");
+        }
+    }
+}
+
+void Server::handle_input(const Input& input) {
+    if (!rollback || status.phase() != Status::STARTED) {
+        return;
+    }
+
+    auto player_id = get_player_id_by_token(input.token());
+    if (!player_id) {
+        return;
+    }
+
+    if (input.has_checksum_frame()) {
+        compare_checksums(*player_id, input.checksum_frame(), input.checksum());
+    }
+
+    // the peer must never learn the sender's token, and has no use for its checksum
+    Input relayed = input;
+    relayed.clear_token();
+    relayed.clear_checksum_frame();
+    relayed.clear_checksum();
+    relayed.set_player(*player_id);
+
+    auto peer = token_addresses.find(*player_id == Player::PLAYER_1 ? tokens.token_2() : tokens.token_1());
+    if (peer != token_addresses.end()) {
+        send(relayed, peer->second);
+    }
+}
+
+// neither player is the authority, so a mismatch can only be reported - its frame is where replaying both
+// players' inputs from the seed starts to tell their simulations apart
+void Server::compare_checksums(Player::Identifier player_id, uint32_t frame, uint32_t checksum) {
+    size_t slot = (frame / MULTI_PONG_ROLLBACK_CHECKSUM_INTERVAL) % reported_checksums[player_id].size();
+    reported_checksums[player_id][slot] = { frame, checksum };
+
+    const ReportedChecksum& other = reported_checksums[1 - player_id][slot];
+
+    if (other.frame == frame && other.checksum != checksum && desynchronised_frame == 0) {
+        desynchronised_frame = frame;
+        LOGGER_ERROR("Players desynchronised by frame ", frame, " with seed ", simulation.get_seed(), " - checksums ", checksum, " and ", other.checksum);
+    }
+}
+
 void Server::start_match() {
-    Logger::info("All players have joined - starting match");
+    LOGGER_INFO("All players have joined - starting match");
     status.set_phase(Status::STARTED);
+    send_heartbeat();
+
+    if (rollback) {
+        Rollback rollback_message;
+        rollback_message.set_seed(simulation.get_seed());
+
+        for (const auto& [token, address] : token_addresses) {
+            send(rollback_message, address, true);
+        }
+
+        LOGGER_INFO("Relaying inputs for a rollback match with seed ", simulation.get_seed());
+        return;
+    }
+
     std::thread game_thread(&Server::game_loop, this);
     game_thread.detach();
 }
 
 void Server::game_loop() {
-    Ball* ball = state.mutable_ball();
-    
-    reset_ball();
+    if (simulation.get_mode() == Simulation::Mode::Fixed) {
+        LOGGER_INFO("Simulating in fixed point with seed ", simulation.get_seed());
+    }
+
+    simulation.reset_ball(state);
 
 #ifdef _WIN32
     timeBeginPeriod(1);
 #endif
 
-    while (status.phase() == Status::STARTED) {
-        
-        ball->set_x(ball->x() + ball_velocity[0]);
-        ball->set_y(ball->y() + ball_velocity[1]);
+    // ticks are scheduled against a fixed timeline rather than slept between, so the tick rate matches
+    // the client-side prediction instead of drifting by the sleep overshoot
+    auto next_tick = std::chrono::steady_clock::now();
 
-        if (ball->y() <= 0.0f || ball->y() >= 1.0f) {
-            ball_velocity[1] *= -1;
-        }
-
-        if (ball->x() <= 0.0f || ball->x() >= 1.0f) {
-            Player::Identifier player_id = ball->x() < 0.0f ? Player::PLAYER_2 : Player::PLAYER_1;
-            std::string scoring_token = get_token_by_player_id(player_id);
-            clients[scoring_token].set_score(clients[scoring_token].score() + 1);
-            reset_ball();
-        }
-
-        for (auto& [token, player] : clients) {
-            float paddle_location = player.paddle_location();
+    while (status.phase() == Status::STARTED) {
+        auto tick_start = std::chrono::steady_clock::now();
 
-            if (player.paddle_direction() == Direction::UP) {
-                paddle_location -= MULTI_PONG_PADDLE_SPEED;
-            } else if (player.paddle_direction() == Direction::DOWN) {
-                paddle_location += MULTI_PONG_PADDLE_SPEED;
-            }
-            
-            player.set_paddle_location(std::clamp(paddle_location, 0.0f, 1.0f));
-        }
+        apply_movements();
+        simulation.step(state, clients[tokens.token_1()], clients[tokens.token_2()]);
+        send_state_to_all_players();
 
-        float relative_hit = 0.0f;
-        bool is_ball_moving_left = ball_velocity[0] < 0.0f;
-        float paddle_x = is_ball_moving_left ? MULTI_PONG_PADDLE_HORIZONTAL_PADDING : 1 - MULTI_PONG_PADDLE_HORIZONTAL_PADDING;
-        float paddle_y = clients[is_ball_moving_left ? tokens.token_1() : tokens.token_2()].paddle_location();
+        auto busy = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tick_start);
+        float tick_load = static_cast<float>(busy.count()) / MULTI_PONG_SERVER_UPDATE_RATE;
+        load = load * 0.95f + tick_load * 0.05f;
 
-        if (did_ball_hit_paddle(paddle_x, paddle_y, relative_hit)) {
-            ball_velocity[0] *= -1 - (MULTI_PONG_PADDLE_HIT_EDGE_FACTOR * abs(relative_hit - 0.5f));
+        next_tick += std::chrono::microseconds(MULTI_PONG_SERVER_UPDATE_RATE);
+        if (next_tick < std::chrono::steady_clock::now()) {
+            next_tick = std::chrono::steady_clock::now();
         }
-
-        state.set_frame(state.frame() + 1);
-        send_state_to_all_players();
-
-        std::this_thread::sleep_for(std::chrono::microseconds(MULTI_PONG_SERVER_UPDATE_RATE));
+        std::this_thread::sleep_until(next_tick);
     }
 
 #ifdef _WIN32
@@ -266,51 +573,61 @@ void Server::game_loop() {
 #endif
 }
 
-void Server::reset_ball() {
-    constexpr float INITIAL_BALL_VELOCITY = 0.0025f;
-    ball_velocity[0] = (std::rand() % 2 ? -1 : 1) * INITIAL_BALL_VELOCITY;
-    ball_velocity[1] = (std::rand() % 2 ? -1 : 1) * INITIAL_BALL_VELOCITY;
-    state.mutable_ball()->set_x(0.5f);
-    state.mutable_ball()->set_y(0.5f);
-}
+void Server::send_state_to_all_players() {
+    // the clients map is unordered, so each player is placed by its identifier
+    for (const auto& [token, player] : clients) {
+        (player.identifier() == Player::PLAYER_1 ? state.mutable_player_1() : state.mutable_player_2())->CopyFrom(player);
+    }
 
-bool Server::did_ball_hit_paddle(float paddle_x, float paddle_y, float& relative_hit) {
-    auto* ball = state.mutable_ball();
-    float ball_x = ball->x();
-    float ball_y = ball->y();
+    // each player is paced by its own snapshot rate, the simulation itself never skips a tick
+    size_t state_bytes = state.ByteSizeLong();
 
-    float ball_left = ball_x - MULTI_PONG_BALL_WIDTH * 0.5f;
-    float ball_right = ball_x + MULTI_PONG_BALL_WIDTH * 0.5f;
-    float ball_top = ball_y - MULTI_PONG_BALL_HEIGHT * 0.5f;
-    float ball_bottom = ball_y + MULTI_PONG_BALL_HEIGHT * 0.5f;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+
+        for (const auto& [token, player] : clients) {
+            if (!connections[token].snapshot_rate.tick(state.frame(), state_bytes)) {
+                continue;
+            }
 
-    float paddle_left = paddle_x - MULTI_PONG_PADDLE_WIDTH * 0.5f;
-    float paddle_right = paddle_x + MULTI_PONG_PADDLE_WIDTH * 0.5f;
-    float paddle_top = paddle_y - MULTI_PONG_PADDLE_HEIGHT * 0.5f;
-    float paddle_bottom = paddle_y + MULTI_PONG_PADDLE_HEIGHT * 0.5f;
+            auto address = token_addresses.find(token);
+            if (address == token_addresses.end()) {
+                continue;
+            }
 
-    if (ball_left < paddle_right && ball_right > paddle_left && ball_top < paddle_bottom && ball_bottom > paddle_top) {
-        float hit_y = (std::max(ball_top, paddle_top) + std::min(ball_bottom, paddle_bottom)) * 0.5f;
-        relative_hit = (hit_y - paddle_top) / MULTI_PONG_PADDLE_HEIGHT;
-        return true;
+            state.set_token(token);
+            send(state, address->second);
+        }
     }
 
-    return false;
+    send_state_to_spectators();
 }
 
-void Server::send_state_to_all_players() {
-    auto it = clients.begin();
-    state.mutable_player_1()->CopyFrom(it->second);
-    it++;
-    state.mutable_player_2()->CopyFrom(it->second);
-    for (const auto& [token, player] : clients) {
-        state.set_token(token);
-        send(state, token_addresses[token]);
+// the state is serialised once per tick however many spectators there are
+void Server::send_state_to_spectators() {
+    std::lock_guard<std::mutex> lock(spectators_mutex);
+
+    if (spectators.empty()) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    spectators.erase(std::remove_if(spectators.begin(), spectators.end(), [&](const Spectator& spectator) {
+        return spectator.expires_at <= now;
+    }), spectators.end());
+
+    State* spectator_state = spectator_message.mutable_state();
+    spectator_state->CopyFrom(state);
+    spectator_state->set_token("");
+    spectator_message.SerializeToString(&serialised_spectator_message);
+
+    for (const Spectator& spectator : spectators) {
+        sendto(server_socket, serialised_spectator_message.data(), static_cast<int>(serialised_spectator_message.size()), 0, (struct sockaddr*)&spectator.address, sizeof(spectator.address));
     }
 }
 
 template<typename T>
-void Server::send(const T& data, const sockaddr_in& address) {
+void Server::send(const T& data, const sockaddr_in& address, bool reliable) {
     Message message;
 
     if constexpr (std::is_same_v<T, Status>) {
@@ -319,15 +636,38 @@ void Server::send(const T& data, const sockaddr_in& address) {
         message.mutable_state()->CopyFrom(data);
     } else if constexpr (std::is_same_v<T, Tokens>) {
         message.mutable_tokens()->CopyFrom(data);
+    } else if constexpr (std::is_same_v<T, Heartbeat>) {
+        message.mutable_heartbeat()->CopyFrom(data);
+    } else if constexpr (std::is_same_v<T, Pong>) {
+        message.mutable_pong()->CopyFrom(data);
+    } else if constexpr (std::is_same_v<T, Input>) {
+        message.mutable_input()->CopyFrom(data);
+    } else if constexpr (std::is_same_v<T, Rollback>) {
+        message.mutable_rollback()->CopyFrom(data);
     } else {
         return;
     }
 
+    if (reliable) {
+        auto peer = reliable_peers.find(address_key(address));
+        if (peer != reliable_peers.end()) {
+            peer->second.channel.send(message, std::chrono::steady_clock::now());
+        }
+    }
+
+    send_message(message, address);
+}
+
+void Server::send_message(const Message& message, const sockaddr_in& address) {
     std::string serialised_message;
     message.SerializeToString(&serialised_message);
     sendto(server_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0, (struct sockaddr*)&address, sizeof(address));
 }
 
-template void Server::send<Status>(const Status&, const sockaddr_in& address);
-template void Server::send<State>(const State&, const sockaddr_in& address);
-template void Server::send<Tokens>(const Tokens&, const sockaddr_in& address);
+template void Server::send<Status>(const Status&, const sockaddr_in& address, bool reliable);
+template void Server::send<State>(const State&, const sockaddr_in& address, bool reliable);
+template void Server::send<Tokens>(const Tokens&, const sockaddr_in& address, bool reliable);
+template void Server::send<Heartbeat>(const Heartbeat&, const sockaddr_in& address, bool reliable);
+template void Server::send<Pong>(const Pong&, const sockaddr_in& address, bool reliable);
+template void Server::send<Input>(const Input&, const sockaddr_in& address, bool reliable);
+template void Server::send<Rollback>(const Rollback&, const sockaddr_in& address, bool reliable);
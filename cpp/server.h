@@ -1,44 +1,139 @@
 #pragma once
 
 #include "tools/common.h"
+#include "tools/snapshot_rate.h"
+#include "tools/reliable_channel.h"
+#include "tools/spsc_queue.h"
+#include "simulation.h"
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <optional>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <array>
+#include <cstdint>
 
 
+struct ServerOptions {
+    Simulation::Mode mode = Simulation::Mode::Float;
+    uint64_t seed = 0;
+    bool rollback = false;  // let the players simulate, relaying only their inputs
+    uint32_t client_bandwidth = 0;  // bytes per second of states per player, zero for no ceiling
+};
+
 class Server {
     private:
         int port;
         multi_pong::Tokens tokens;
         std::string secret = "";
-        float ball_velocity[2] = {0.0f, 0.0f};
+        Simulation simulation;
         multi_pong::State state;
         multi_pong::Status status;
         std::unordered_map<std::string, multi_pong::Player> clients;
         std::unordered_map<std::string, sockaddr_in> token_addresses;
         socket_t server_socket;
+        sockaddr_in coordinator_address{};
+        std::chrono::steady_clock::time_point next_heartbeat;
+        std::chrono::steady_clock::time_point prepare_expires_at;
+        std::atomic<float> load{ 0.0f };
+
+        // spectators receive every state without a token, they are dropped once they stop resubscribing
+        struct Spectator {
+            sockaddr_in address;
+            std::chrono::steady_clock::time_point expires_at;
+        };
+
+        // pings are counted per player so the client can split loss by direction, and the figures it
+        // reports back are kept for the listen thread - the snapshot rate is shared with the game thread
+        struct Connection {
+            uint32_t pings_received = 0;
+            multi_pong::Ping report;
+            SnapshotRate snapshot_rate;
+        };
+
+        // players and the state belong to the game thread once the match starts, so the listen thread only
+        // queues what arrived and each tick applies it before stepping
+        struct PendingMovement {
+            multi_pong::Player::Identifier player;
+            multi_pong::Direction direction;
+            bool has_sequence;
+            uint32_t sequence;
+            int history_size;
+            std::array<uint32_t, MULTI_PONG_MOVEMENT_HISTORY> history;
+        };
+
+        SpscQueue<PendingMovement, MULTI_PONG_MOVEMENT_QUEUE> pending_movements;
+
+        std::unordered_map<std::string, Connection> connections;
+        std::mutex connections_mutex;
+        uint32_t client_bandwidth = 0;
+
+        // in rollback mode the players simulate the match themselves, the server only relays their inputs
+        // and compares the checksums they report for the same frame
+        struct ReportedChecksum {
+            uint32_t frame = 0;
+            uint32_t checksum = 0;
+        };
+
+        bool rollback = false;
+        std::array<std::array<ReportedChecksum, 8>, 2> reported_checksums{};
+        uint32_t desynchronised_frame = 0;
+
+        // control messages go over a reliable channel to any peer that sent one that way itself, so older
+        // clients and coordinators still get them once as before - only the listen thread touches these
+        struct ReliablePeer {
+            sockaddr_in address;
+            ReliableChannel channel;
+        };
+
+        std::unordered_map<uint64_t, ReliablePeer> reliable_peers;
+        std::unordered_set<uint64_t> player_address_keys;  // the peers kept until the tokens are replaced
+        std::vector<multi_pong::Message> delivered_messages;
+
+        std::vector<Spectator> spectators;
+        std::mutex spectators_mutex;
+        multi_pong::Message spectator_message;
+        std::string serialised_spectator_message;
 
         multi_pong::Tokens generate_tokens();
-        std::string generate_random_sequence();
         void listen();
+        void receive_message(const multi_pong::Message& message, const sockaddr_in& address);
+        void handle_message(const multi_pong::Message& message, const sockaddr_in& address);
+        bool accepts_reliable_peer(const multi_pong::Message& message, const sockaddr_in& address);
+        void flush_reliable_peers(std::chrono::steady_clock::time_point now);
+        void send_heartbeat();
+        void expire_preparation();
         void handle_query(const sockaddr_in& address);
         void handle_prepare(const multi_pong::Prepare& prepare, const sockaddr_in& address);
         void handle_join(const multi_pong::Join& join, const sockaddr_in& address);
-        void handle_movement(const multi_pong::Movement& movement, const sockaddr_in& address);
+        void handle_movement(const multi_pong::Movement& movement);
+        void apply_movements();
+        void replay_missed_inputs(multi_pong::Player& player, const PendingMovement& movement);
+        void handle_spectate(const sockaddr_in& address);
+        void handle_ping(const multi_pong::Ping& ping, const sockaddr_in& address);
+        void handle_input(const multi_pong::Input& input);
+        void compare_checksums(multi_pong::Player::Identifier player_id, uint32_t frame, uint32_t checksum);
         void start_match();
         void game_loop();
-        void reset_ball();
-        bool did_ball_hit_paddle(float paddle_x, float paddle_y, float& relative_hit);
         void send_state_to_all_players();
+        void send_state_to_spectators();
 
         template<typename T>
-        void send(const T& data, const sockaddr_in& address);
+        void send(const T& data, const sockaddr_in& address, bool reliable = false);
+        void send_message(const multi_pong::Message& message, const sockaddr_in& address);
 
-        std::string get_token_by_player_id(const multi_pong::Player::Identifier& player_id);
         std::optional<multi_pong::Player::Identifier> get_player_id_by_token(const std::string& token);
 
     public:
-        Server(int port);
+        Server(int port, const std::pair<std::string, int>& coordinator, const ServerOptions& options = ServerOptions());
         ~Server();
+
+        // per-packet helpers that need no server, public so benchmarks can time them
+        static std::string generate_random_sequence();
+        static std::optional<multi_pong::Player::Identifier> get_player_id_by_token(const multi_pong::Tokens& tokens, const std::string& token);
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "server.h"
+#include "tools/logger.h"
+#include "tools/common.h"
+#include "tools/options.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <random>
+#include <iostream>
+#include <cstdint>
+
+struct Arguments {
+	bool invalid = false;
+	int port = MULTI_PONG_SERVER_PORT;
+	std::pair<std::string, int> coordinator_address = MULTI_PONG_COORDINATOR_ADDRESS;
+	ServerOptions server_options;
+	bool seeded = false;
+	LogOptions log_options;
+};
+
+static Arguments parse_arguments(int argc, char** argv) {
+	Arguments arguments;
+	arguments.invalid = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string argument = argv[i];
+
+		if (OptionResult result = parse_log_option(argc, argv, i, arguments.log_options); result != OptionResult::Unknown) {
+			if (result == OptionResult::Invalid) return arguments;
+		} else if (argument == "--port") {
+			std::optional<int> port = i + 1 < argc ? parse_port(argv[++i]) : std::nullopt;
+			if (!port) {
+				LOGGER_ERROR("Specify a valid port number with --port <1-65535>");
+				return arguments;
+			}
+			arguments.port = *port;
+		} else if (argument == "--coordinator-address") {
+			if (i + 1 < argc) {
+				if (auto address = parse_address(argv[++i])) {
+					arguments.coordinator_address = *address;
+				} else {
+					LOGGER_ERROR("Invalid coordinator address: ", argv[i]);
+					return arguments;
+				}
+			} else {
+				LOGGER_ERROR("Specify the coordinator to register with using --coordinator-address <address:port>");
+				return arguments;
+			}
+		} else if (argument == "--fixed-point") {
+			arguments.server_options.mode = Simulation::Mode::Fixed;
+		} else if (argument == "--rollback") {
+			arguments.server_options.mode = Simulation::Mode::Fixed;
+			arguments.server_options.rollback = true;
+		} else if (argument == "--seed") {
+			std::optional<uint64_t> seed = i + 1 < argc ? parse_unsigned(argv[++i]) : std::nullopt;
+			if (!seed) {
+				LOGGER_ERROR("Specify the seed as a non-negative integer with --seed <n>");
+				return arguments;
+			}
+			arguments.server_options.seed = *seed;
+			arguments.seeded = true;
+		} else if (argument == "--client-bandwidth") {
+			std::optional<uint64_t> bandwidth = i + 1 < argc ? parse_unsigned(argv[++i]) : std::nullopt;
+			if (!bandwidth || *bandwidth > UINT32_MAX) {
+				LOGGER_ERROR("Specify the ceiling in bytes per second with --client-bandwidth <n>");
+				return arguments;
+			}
+			arguments.server_options.client_bandwidth = static_cast<uint32_t>(*bandwidth);
+		} else if (argument == "--help") {
+			std::cout <<
+				"usage: " << argv[0] << " [options]\n\n"
+				"options:\n"
+				"  --port <1-65535>              port to listen on <" << MULTI_PONG_SERVER_PORT << ">\n"
+				"  --coordinator-address <host:port>\n"
+				"                                coordinator to send heartbeats to\n"
+				"  --fixed-point                 simulate in fixed point so matches can be replayed bit for bit\n"
+				"  --rollback                    let the players simulate in fixed point, only relaying their inputs\n"
+				"  --seed <n>                    seed for the ball's starting directions <random>\n"
+				"  --client-bandwidth <n>        ceiling on the states sent to each player, bytes per second <none>\n"
+				<< LOG_OPTIONS_HELP <<
+				"  --help                        show help\n";
+			return arguments;
+		}
+	}
+
+	arguments.invalid = false;
+	return arguments;
+}
+
+int main(int argc, char** argv) {
+	Arguments arguments = parse_arguments(argc, argv);
+
+	if (arguments.invalid || !apply_log_options(arguments.log_options)) {
+		return -1;
+	}
+
+	if (!arguments.seeded) {
+		arguments.server_options.seed = (static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}();
+	}
+
+	Server server = Server(arguments.port, arguments.coordinator_address, arguments.server_options);
+	return 0;
+}
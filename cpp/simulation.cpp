@@ -0,0 +1,145 @@
+#include "simulation.h"
+
+#include <type_traits>
+#include <cmath>
+#include <algorithm>
+
+using namespace multi_pong;
+
+// a float in either representation - rounded to the nearest fixed point step, at compile time for constants
+template<typename Scalar>
+static constexpr Scalar scalar(float value) {
+    if constexpr (std::is_same_v<Scalar, Fixed>) {
+        return Fixed::from_float(value);
+    } else {
+        return value;
+    }
+}
+
+static Fixed step_paddle(Fixed paddle_location, Direction direction) {
+    if (direction == Direction::UP) {
+        paddle_location -= scalar<Fixed>(MULTI_PONG_PADDLE_SPEED);
+    } else if (direction == Direction::DOWN) {
+        paddle_location += scalar<Fixed>(MULTI_PONG_PADDLE_SPEED);
+    }
+    return std::clamp(paddle_location, Fixed(), scalar<Fixed>(1.0f));
+}
+
+template<typename Scalar>
+static bool hit_paddle(Scalar ball_x, Scalar ball_y, Scalar paddle_x, Scalar paddle_y, Scalar& relative_hit) {
+    Scalar ball_left = ball_x - scalar<Scalar>(MULTI_PONG_BALL_WIDTH * 0.5f);
+    Scalar ball_right = ball_x + scalar<Scalar>(MULTI_PONG_BALL_WIDTH * 0.5f);
+    Scalar ball_top = ball_y - scalar<Scalar>(MULTI_PONG_BALL_HEIGHT * 0.5f);
+    Scalar ball_bottom = ball_y + scalar<Scalar>(MULTI_PONG_BALL_HEIGHT * 0.5f);
+
+    Scalar paddle_left = paddle_x - scalar<Scalar>(MULTI_PONG_PADDLE_WIDTH * 0.5f);
+    Scalar paddle_right = paddle_x + scalar<Scalar>(MULTI_PONG_PADDLE_WIDTH * 0.5f);
+    Scalar paddle_top = paddle_y - scalar<Scalar>(MULTI_PONG_PADDLE_HEIGHT * 0.5f);
+    Scalar paddle_bottom = paddle_y + scalar<Scalar>(MULTI_PONG_PADDLE_HEIGHT * 0.5f);
+
+    if (ball_left < paddle_right && ball_right > paddle_left && ball_top < paddle_bottom && ball_bottom > paddle_top) {
+        Scalar hit_y = (std::max(ball_top, paddle_top) + std::min(ball_bottom, paddle_bottom)) * scalar<Scalar>(0.5f);
+        relative_hit = (hit_y - paddle_top) / scalar<Scalar>(MULTI_PONG_PADDLE_HEIGHT);
+        return true;
+    }
+
+    return false;
+}
+
+Simulation::Simulation(Mode simulation_mode, uint64_t simulation_seed) : mode(simulation_mode), seed(simulation_seed), random(simulation_seed) {}
+
+template<typename Scalar>
+void Simulation::reset_ball(World<Scalar>& world) {
+    constexpr Scalar INITIAL_BALL_VELOCITY = scalar<Scalar>(0.0025f);
+    world.velocity_x = random.coin() ? -INITIAL_BALL_VELOCITY : INITIAL_BALL_VELOCITY;
+    world.velocity_y = random.coin() ? -INITIAL_BALL_VELOCITY : INITIAL_BALL_VELOCITY;
+    world.ball_x = scalar<Scalar>(0.5f);
+    world.ball_y = scalar<Scalar>(0.5f);
+}
+
+void Simulation::reset_ball(State& state) {
+    if (mode == Mode::Fixed) {
+        reset_ball(fixed_world);
+    } else {
+        reset_ball(float_world);
+    }
+
+    state.mutable_ball()->set_x(0.5f);
+    state.mutable_ball()->set_y(0.5f);
+}
+
+template<typename Scalar>
+void Simulation::step(World<Scalar>& world, State& state, Player& player_1, Player& player_2) {
+    using std::abs;
+
+    world.ball_x += world.velocity_x;
+    world.ball_y += world.velocity_y;
+
+    if (world.ball_y <= Scalar() || world.ball_y >= scalar<Scalar>(1.0f)) {
+        world.velocity_y = -world.velocity_y;
+    }
+
+    if (world.ball_x <= Scalar() || world.ball_x >= scalar<Scalar>(1.0f)) {
+        Player& scorer = world.ball_x < Scalar() ? player_2 : player_1;
+        scorer.set_score(scorer.score() + 1);
+        reset_ball(world);
+    }
+
+    // paddle locations written by a fixed point tick convert back exactly
+    Scalar paddle_1 = step_paddle(scalar<Scalar>(player_1.paddle_location()), player_1.paddle_direction());
+    Scalar paddle_2 = step_paddle(scalar<Scalar>(player_2.paddle_location()), player_2.paddle_direction());
+    player_1.set_paddle_location(static_cast<float>(paddle_1));
+    player_2.set_paddle_location(static_cast<float>(paddle_2));
+
+    Scalar relative_hit{};
+    bool is_ball_moving_left = world.velocity_x < Scalar();
+    Scalar paddle_x = scalar<Scalar>(is_ball_moving_left ? MULTI_PONG_PADDLE_HORIZONTAL_PADDING : 1 - MULTI_PONG_PADDLE_HORIZONTAL_PADDING);
+    Scalar paddle_y = is_ball_moving_left ? paddle_1 : paddle_2;
+
+    if (hit_paddle(world.ball_x, world.ball_y, paddle_x, paddle_y, relative_hit)) {
+        world.velocity_x *= -scalar<Scalar>(1.0f) - (scalar<Scalar>(MULTI_PONG_PADDLE_HIT_EDGE_FACTOR) * abs(relative_hit - scalar<Scalar>(0.5f)));
+    }
+
+    state.mutable_ball()->set_x(static_cast<float>(world.ball_x));
+    state.mutable_ball()->set_y(static_cast<float>(world.ball_y));
+    state.set_frame(state.frame() + 1);
+}
+
+void Simulation::step(State& state, Player& player_1, Player& player_2) {
+    if (mode == Mode::Fixed) {
+        step(fixed_world, state, player_1, player_2);
+        state.set_checksum(checksum(state, player_1, player_2));
+    } else {
+        step(float_world, state, player_1, player_2);
+    }
+}
+
+void Simulation::shift_paddle(Player& player, int32_t steps) const {
+    if (mode == Mode::Fixed) {
+        Fixed location = scalar<Fixed>(player.paddle_location()) + scalar<Fixed>(MULTI_PONG_PADDLE_SPEED) * steps;
+        player.set_paddle_location(static_cast<float>(std::clamp(location, Fixed(), scalar<Fixed>(1.0f))));
+    } else {
+        float location = player.paddle_location() + static_cast<float>(steps) * MULTI_PONG_PADDLE_SPEED;
+        player.set_paddle_location(std::clamp(location, 0.0f, 1.0f));
+    }
+}
+
+// in this order: frame, ball x and y, ball velocity x and y, paddle 1 and 2, score 1 and 2, generator state
+uint32_t Simulation::checksum(const State& state, const Player& player_1, const Player& player_2) const {
+    return Checksum()
+        .add(state.frame())
+        .add(fixed_world.ball_x)
+        .add(fixed_world.ball_y)
+        .add(fixed_world.velocity_x)
+        .add(fixed_world.velocity_y)
+        .add(scalar<Fixed>(player_1.paddle_location()))
+        .add(scalar<Fixed>(player_2.paddle_location()))
+        .add(player_1.score())
+        .add(player_2.score())
+        .add(random.get_state())
+        .get();
+}
+
+bool Simulation::did_ball_hit_paddle(const Ball& ball, float paddle_x, float paddle_y, float& relative_hit) {
+    return hit_paddle(ball.x(), ball.y(), paddle_x, paddle_y, relative_hit);
+}
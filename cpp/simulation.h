@@ -0,0 +1,58 @@
+#pragma once
+
+#include "tools/common.h"
+#include "tools/deterministic.h"
+
+#include <cstdint>
+
+
+// the rules of a match with nothing about sockets, threads or time - a tick moves the ball, scores it
+// when it leaves the court, moves both paddles and bounces the ball off the paddle it is heading for
+//
+// the same rules run on floats or on Q16.16 fixed point - fixed point gives identical states for identical
+// seeds and inputs everywhere, positions still go out as floats since every fixed value converts exactly
+class Simulation {
+    public:
+        enum class Mode {
+            Float,
+            Fixed
+        };
+
+    private:
+        template<typename Scalar>
+        struct World {
+            Scalar ball_x{};
+            Scalar ball_y{};
+            Scalar velocity_x{};
+            Scalar velocity_y{};
+        };
+
+        Mode mode;
+        uint64_t seed;
+        Random random;
+        World<float> float_world;
+        World<Fixed> fixed_world;
+
+        template<typename Scalar>
+        void reset_ball(World<Scalar>& world);
+
+        template<typename Scalar>
+        void step(World<Scalar>& world, multi_pong::State& state, multi_pong::Player& player_1, multi_pong::Player& player_2);
+
+    public:
+        explicit Simulation(Mode mode = Mode::Float, uint64_t seed = 0);
+
+        static bool did_ball_hit_paddle(const multi_pong::Ball& ball, float paddle_x, float paddle_y, float& relative_hit);
+
+        void reset_ball(multi_pong::State& state);
+        void step(multi_pong::State& state, multi_pong::Player& player_1, multi_pong::Player& player_2);
+
+        // moves a paddle by whole paddle steps outside a tick, for inputs replayed after the fact
+        void shift_paddle(multi_pong::Player& player, int32_t steps) const;
+
+        // everything the next tick depends on besides the inputs, only meaningful in fixed point
+        uint32_t checksum(const multi_pong::State& state, const multi_pong::Player& player_1, const multi_pong::Player& player_2) const;
+
+        Mode get_mode() const { return mode; }
+        uint64_t get_seed() const { return seed; }
+};
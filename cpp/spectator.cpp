@@ -0,0 +1,119 @@
+#include "spectator.h"
+#include "tools/logger.h"
+
+#include <thread>
+#include <string>
+
+using namespace multi_pong;
+
+Spectator::Spectator(const std::vector<std::pair<std::string, int>>& servers, std::unique_ptr<WallRenderer> wall_renderer) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        LOGGER_ERROR("Failed to initialise Winsock");
+        return;
+    }
+#endif
+
+    spectator_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (spectator_socket < 0) {
+        LOGGER_ERROR("Failed to create spectator socket");
+        return;
+    }
+
+    for (const auto& [host, port] : servers) {
+        auto match = std::make_unique<Match>();
+        memset(&match->address, 0, sizeof(match->address));
+        match->address.sin_family = AF_INET;
+        match->address.sin_port = htons(port);
+
+        if (inet_pton(AF_INET, host.c_str(), &match->address.sin_addr) != 1) {
+            LOGGER_WARNING("Skipping invalid server address ", host, ":", port);
+            continue;
+        }
+
+        if (match_index.count(address_key(match->address))) continue;
+
+        match_index[address_key(match->address)] = matches.size();
+        matches.push_back(std::move(match));
+    }
+
+    LOGGER_INFO("Spectating ", matches.size(), " servers");
+
+    // the receive timeout bounds how late a resubscription can be when no states arrive
+#ifdef _WIN32
+    DWORD timeout = MULTI_PONG_SPECTATE_INTERVAL;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = MULTI_PONG_SPECTATE_INTERVAL / 1000;
+    timeout.tv_usec = (MULTI_PONG_SPECTATE_INTERVAL % 1000) * 1000;
+#endif
+    setsockopt(spectator_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    renderer = std::move(wall_renderer);
+    renderer->setup(this);
+
+    std::thread listen_thread(&Spectator::listen, this);
+    listen_thread.detach();
+
+    renderer->render_loop();
+}
+
+Spectator::~Spectator() {
+    active = false;
+    close_socket(spectator_socket);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void Spectator::subscribe() {
+    Message message;
+    message.mutable_spectate()->CopyFrom(Spectate());
+    std::string serialised_message = message.SerializeAsString();
+
+    for (const auto& match : matches) {
+        sendto(spectator_socket, serialised_message.data(), static_cast<int>(serialised_message.size()), 0, (struct sockaddr*)&match->address, sizeof(match->address));
+    }
+
+    next_subscription = std::chrono::steady_clock::now() + std::chrono::milliseconds(MULTI_PONG_SPECTATE_INTERVAL);
+}
+
+void Spectator::listen() {
+    char buffer[MULTI_PONG_SERVER_BUFFER];
+    sockaddr_in source_address{};
+    socklen_t source_address_len = sizeof(source_address);
+    Message received_message;
+
+    subscribe();
+
+    while (active) {
+        int received = recvfrom(spectator_socket, buffer, sizeof(buffer), 0, (sockaddr*)&source_address, &source_address_len);
+
+        if (std::chrono::steady_clock::now() >= next_subscription) {
+            subscribe();
+        }
+
+        if (received < 0) continue;
+
+        auto index = match_index.find(address_key(source_address));
+        if (index == match_index.end()) continue;
+
+        if (!received_message.ParseFromArray(buffer, received) || !received_message.has_state()) continue;
+
+        Match& match = *matches[index->second];
+        read_snapshot(received_message.state(), now_microseconds(), match.received_snapshots.write_buffer());
+        match.received_snapshots.publish();
+        renderer->update_state();
+    }
+}
+
+const Snapshot* Spectator::get_snapshot(size_t index) {
+    Match& match = *matches[index];
+
+    if (match.received_snapshots.update()) {
+        match.live = true;
+    }
+
+    return match.live ? &match.received_snapshots.read_buffer() : nullptr;
+}
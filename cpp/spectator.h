@@ -0,0 +1,45 @@
+#pragma once
+
+#include "tools/common.h"
+#include "tools/renderer_wall.h"
+#include "tools/snapshot_buffer.h"
+#include "tools/triple_buffer.h"
+
+#include <string>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <chrono>
+
+
+// watches many matches at once without playing - one socket subscribes to every server and incoming
+// states are routed to their match by source address, each match handing its latest state to the
+// render thread through its own triple buffer
+class Spectator {
+    private:
+        struct Match {
+            sockaddr_in address;
+            TripleBuffer<Snapshot> received_snapshots;
+            bool live = false;  // render thread only, set once the first state has been read
+        };
+
+        std::unique_ptr<WallRenderer> renderer;
+        socket_t spectator_socket;
+        std::vector<std::unique_ptr<Match>> matches;
+        std::unordered_map<uint64_t, size_t> match_index;  // address key to match, fixed after construction
+        std::chrono::steady_clock::time_point next_subscription;
+
+        std::atomic<bool> active{ true };
+
+        void listen();
+        void subscribe();
+
+    public:
+        Spectator(const std::vector<std::pair<std::string, int>>& servers, std::unique_ptr<WallRenderer> wall_renderer);
+        ~Spectator();
+
+        size_t match_count() const { return matches.size(); }
+        const Snapshot* get_snapshot(size_t index);
+};
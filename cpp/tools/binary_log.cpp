@@ -0,0 +1,88 @@
+#include "binary_log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool BinaryLog::open(const std::string& path, size_t size) {
+    if (is_open() || size <= sizeof(binary_log::MAGIC)) {
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    HANDLE view_mapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), nullptr);
+    void* view = view_mapping ? MapViewOfFile(view_mapping, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+
+    if (!view) {
+        if (view_mapping) CloseHandle(view_mapping);
+        CloseHandle(handle);
+        return false;
+    }
+
+    file = handle;
+    mapping = view_mapping;
+#else
+    int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        return false;
+    }
+
+    // the file is extended without writing to it, so only the pages that are logged to take up space
+    void* view = ftruncate(descriptor, static_cast<off_t>(size)) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+
+    if (view == MAP_FAILED) {
+        ::close(descriptor);
+        return false;
+    }
+
+    file = descriptor;
+#endif
+
+    base = static_cast<char*>(view);
+    capacity = size;
+    std::memcpy(base, binary_log::MAGIC, sizeof(binary_log::MAGIC));
+    used.store(sizeof(binary_log::MAGIC), std::memory_order_relaxed);
+    mapped.store(true, std::memory_order_release);
+    return true;
+}
+
+char* BinaryLog::reserve(size_t size) {
+    size_t offset = used.fetch_add(size, std::memory_order_relaxed);
+
+    if (offset + size > capacity) {
+        return nullptr;
+    }
+
+    return base + offset;
+}
+
+// threads may still be filling entries they reserved, so the view stays mapped until the process exits -
+// pushing the write offset past the end makes every later reservation fail, and everything reserved before
+// that lies inside the size the file is cut down to
+void BinaryLog::close() {
+    if (!mapped.exchange(false, std::memory_order_acq_rel)) {
+        return;
+    }
+
+    size_t end = std::min(used.fetch_add(capacity + 1, std::memory_order_relaxed), capacity);
+
+#ifdef _WIN32
+    // a mapped file cannot be shortened on windows, the zeroed tail reads as the end of the log
+    FlushViewOfFile(base, end);
+#else
+    msync(base, end, MS_ASYNC);
+    [[maybe_unused]] int result = ftruncate(file, static_cast<off_t>(end));  // the zeroed tail reads as the end anyway
+#endif
+}
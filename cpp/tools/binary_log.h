@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// file layout shared by Logger and the log decoder - the file starts with MAGIC and is followed by entries
+// until one with a zero size, each an EntryHeader and its payload:
+//
+// Site payload: file (u16 length, bytes), line (u32), argument count (u8), then one Argument per argument,
+// literals followed by their text (u16 length, bytes)
+// Record payload: the value of every argument that is not a literal, in order - 8 bytes for numbers, 1 for
+// bools and chars, u16 length and bytes for text
+namespace binary_log {
+    inline constexpr char MAGIC[8] = { 'M', 'P', 'L', 'O', 'G', 0, 0, 1 };
+    inline constexpr size_t DEFAULT_CAPACITY = size_t(256) << 20;  // bytes, the file is sparse until used
+    inline constexpr size_t MAX_ENTRY = 4096;  // bytes, longer text is cut short
+
+    enum class Kind : uint8_t {
+        End = 0,
+        Site = 1,  // describes a call site the first time it logs
+        Record = 2
+    };
+
+    enum class Argument : uint8_t {
+        Signed,
+        Unsigned,
+        Float,
+        Bool,
+        Char,
+        Text,
+        Literal  // only in site descriptors, the text never appears in records
+    };
+
+#pragma pack(push, 1)
+    struct EntryHeader {
+        uint16_t size;  // header and payload
+        Kind kind;
+        uint8_t level;
+        uint32_t site;
+        int64_t timestamp;  // system clock, nanoseconds since the epoch
+    };
+#pragma pack(pop)
+
+    static_assert(sizeof(EntryHeader) == 16, "entry headers are written to disk as they are");
+}
+
+// append-only memory-mapped file shared by every thread - space is claimed with a single atomic add and
+// filled in place, so writers never wait for each other and no thread ever formats or flushes
+class BinaryLog {
+    private:
+        char* base = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> used{ 0 };
+        std::atomic<bool> mapped{ false };
+
+#ifdef _WIN32
+        void* file = nullptr;  // HANDLEs, kept opaque so windows.h stays out of the header
+        void* mapping = nullptr;
+#else
+        int file = -1;
+#endif
+
+    public:
+        bool open(const std::string& path, size_t size);
+        void close();
+        bool is_open() const { return mapped.load(std::memory_order_acquire); }
+
+        // returns where to write an entry of this size, or nullptr once the file is full or closed
+        char* reserve(size_t size);
+};
@@ -3,6 +3,9 @@
 #include <protobufs/pong.pb.h>
 #include <string>
 #include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
 
 #ifdef _WIN32
 #define NOMINMAX
@@ -10,6 +13,8 @@
 #include <ws2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
 #else
+#include <poll.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -37,8 +42,60 @@ inline constexpr int MULTI_PONG_SERVER_BUFFER = 512;
 inline constexpr int MULTI_PONG_SERVER_CHECK_INTERVAL = 5;
 inline constexpr int MULTI_PONG_SERVER_CHECK_TIMEOUT = 1;
 inline constexpr int MULTI_PONG_SERVER_UPDATE_RATE = 1000000 / 128;  // nanoseconds
+inline constexpr int MULTI_PONG_PREDICTION_HISTORY = 512;  // ticks
+inline constexpr int MULTI_PONG_MOVEMENT_HISTORY = 8;  // earlier inputs repeated in every movement
+inline constexpr size_t MULTI_PONG_MOVEMENT_QUEUE = 256;  // movements waiting for the next tick
+inline constexpr uint32_t MULTI_PONG_ROLLBACK_HISTORY = 128;  // ticks
+inline constexpr uint32_t MULTI_PONG_ROLLBACK_WINDOW = 32;  // ticks simulated past the peer's newest input
+inline constexpr uint32_t MULTI_PONG_ROLLBACK_INPUTS = 64;  // inputs per datagram
+inline constexpr uint32_t MULTI_PONG_ROLLBACK_CHECKSUM_INTERVAL = 64;  // ticks
+inline constexpr int MULTI_PONG_PING_INTERVAL = 250;  // milliseconds
+inline constexpr int MULTI_PONG_PING_WINDOW = 16;  // pings per loss measurement
+inline constexpr int MULTI_PONG_RTT_HISTORY = 64;  // round trips kept for the overlay
+inline constexpr float MULTI_PONG_SNAPSHOT_RATE_MIN = 16.0f;  // states per second
+inline constexpr float MULTI_PONG_SNAPSHOT_RATE_STEP = 8.0f;  // states per second added per clean report
+inline constexpr float MULTI_PONG_SNAPSHOT_LOSS_LIMIT = 0.05f;
+inline constexpr uint32_t MULTI_PONG_SNAPSHOT_QUEUE_LIMIT = 20000;  // microseconds of round trip over the lowest seen
+inline constexpr int MULTI_PONG_LATENCY_PROBE_TIMEOUT = 500;  // milliseconds
+inline constexpr int MULTI_PONG_LATENCY_CANDIDATES = 16;
+inline constexpr int MULTI_PONG_HEARTBEAT_INTERVAL = 1000;  // milliseconds
+inline constexpr int MULTI_PONG_HEARTBEAT_EXPIRY = 3 * MULTI_PONG_HEARTBEAT_INTERVAL;  // milliseconds
+inline constexpr int MULTI_PONG_TIMER_RESOLUTION = 50;  // milliseconds
+inline constexpr int MULTI_PONG_RELIABLE_INITIAL_TIMEOUT = 250;  // milliseconds before the first round trip is measured
+inline constexpr int MULTI_PONG_RELIABLE_MIN_TIMEOUT = 100;  // milliseconds
+inline constexpr int MULTI_PONG_RELIABLE_MAX_TIMEOUT = 2000;  // milliseconds
+inline constexpr uint32_t MULTI_PONG_RELIABLE_ATTEMPTS = 8;  // sends of one message before the peer is given up on
+inline constexpr int MULTI_PONG_PREPARE_EXPIRY = 30000;  // milliseconds a prepared server waits for both players
+inline constexpr int MULTI_PONG_TIMER_SLOTS = 128;
+inline constexpr size_t MULTI_PONG_TOKEN_POOL_SIZE = 4;
+inline constexpr size_t MULTI_PONG_COORDINATOR_QUEUE = 1024;
+inline constexpr size_t MULTI_PONG_QUAD_BATCH_CAPACITY = 4096;
+inline constexpr int MULTI_PONG_FRAME_SPIN_MARGIN = 2000;  // microseconds
+inline constexpr double MULTI_PONG_ON_DEMAND_TIMEOUT = 0.25;  // seconds
+inline constexpr int MULTI_PONG_SPECTATE_INTERVAL = 1000;  // milliseconds
+inline constexpr int MULTI_PONG_SPECTATE_EXPIRY = 3 * MULTI_PONG_SPECTATE_INTERVAL;  // milliseconds
+inline constexpr size_t MULTI_PONG_MAX_SPECTATORS = 64;
+inline constexpr uint32_t MULTI_PONG_LATENCY_UNKNOWN = UINT32_MAX;
 inline const std::pair<std::string, int> MULTI_PONG_COORDINATOR_ADDRESS = { "127.0.0.1", 4999 };
 
+inline int poll_sockets(pollfd* fds, size_t count, int timeout_ms) {
+#ifdef _WIN32
+    return WSAPoll(fds, static_cast<ULONG>(count), timeout_ms);
+#else
+    return poll(fds, static_cast<nfds_t>(count), timeout_ms);
+#endif
+}
+
+inline bool set_non_blocking(socket_t socket_) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(socket_, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(socket_, F_GETFL, 0);
+    return flags >= 0 && fcntl(socket_, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
 inline void close_socket(socket_t socket_) {
 #ifdef _WIN32
     closesocket(socket_);
@@ -47,6 +104,20 @@ inline void close_socket(socket_t socket_) {
 #endif
 }
 
+// shared by the server simulation and client-side prediction, so both move a paddle identically
+inline float step_paddle(float paddle_location, multi_pong::Direction direction) {
+    if (direction == multi_pong::Direction::UP) {
+        paddle_location -= MULTI_PONG_PADDLE_SPEED;
+    } else if (direction == multi_pong::Direction::DOWN) {
+        paddle_location += MULTI_PONG_PADDLE_SPEED;
+    }
+    return std::clamp(paddle_location, 0.0f, 1.0f);
+}
+
+inline int64_t now_microseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 inline std::string address_string(const sockaddr_in& addr) {
     char address_buffer[INET_ADDRSTRLEN];
     if (inet_ntop(AF_INET, &addr.sin_addr, address_buffer, INET_ADDRSTRLEN) == nullptr) {
@@ -54,3 +125,8 @@ inline std::string address_string(const sockaddr_in& addr) {
     }
     return std::string(address_buffer);
 }
+
+// packs an IPv4 address and port into one integer for hashing and comparison
+inline uint64_t address_key(const sockaddr_in& addr) {
+    return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+
+struct ConnectionReport {
+    uint32_t rtt = 0;  // smoothed, microseconds
+    uint32_t jitter = 0;  // mean difference between consecutive round trips, microseconds
+    float upstream_loss = 0.0f;  // fraction lost over the last completed window
+    float downstream_loss = 0.0f;
+    uint32_t windows = 0;  // completed loss windows, the loss figures mean nothing until the first
+    uint32_t samples = 0;  // round trips measured so far
+    std::array<uint32_t, MULTI_PONG_RTT_HISTORY> rtt_history{};  // indexed by sample modulo the size
+};
+
+// turns pongs into rolling connection figures - round trips are smoothed the way TCP does it and jitter
+// follows RTP, while loss is worked out per window of pings from the server's count of pings it received,
+// which splits it into the two directions without synchronised clocks
+class ConnectionMonitor {
+    private:
+        ConnectionReport report;
+        uint32_t last_rtt = 0;
+        uint32_t pongs = 0;
+        uint32_t window_sequence = 0;  // last ping of the previous window
+        uint32_t window_received = 0;
+        uint32_t window_pongs = 0;
+
+    public:
+        // returns true when the pong completed a loss window
+        bool record(uint32_t sequence, uint32_t received, uint32_t rtt) {
+            pongs++;
+
+            if (report.samples == 0) {
+                report.rtt = rtt;
+            } else {
+                int64_t rtt_error = static_cast<int64_t>(rtt) - static_cast<int64_t>(report.rtt);
+                int64_t jitter_error = std::abs(static_cast<int64_t>(rtt) - static_cast<int64_t>(last_rtt)) - static_cast<int64_t>(report.jitter);
+                report.rtt = static_cast<uint32_t>(static_cast<int64_t>(report.rtt) + rtt_error / 8);
+                report.jitter = static_cast<uint32_t>(static_cast<int64_t>(report.jitter) + jitter_error / 16);
+            }
+
+            last_rtt = rtt;
+            report.rtt_history[report.samples % MULTI_PONG_RTT_HISTORY] = rtt;
+            report.samples++;
+
+            // a pong reordered from before the window started only counts towards the returned pongs
+            if (sequence < window_sequence || sequence - window_sequence < MULTI_PONG_PING_WINDOW) {
+                return false;
+            }
+
+            uint32_t sent = sequence - window_sequence;
+            uint32_t arrived = std::min(received - window_received, sent);
+            uint32_t returned = std::min(pongs - window_pongs, arrived);
+
+            report.upstream_loss = 1.0f - static_cast<float>(arrived) / static_cast<float>(sent);
+            report.downstream_loss = arrived ? 1.0f - static_cast<float>(returned) / static_cast<float>(arrived) : 0.0f;
+            report.windows++;
+
+            window_sequence = sequence;
+            window_received = received;
+            window_pongs = pongs;
+            return true;
+        }
+
+        const ConnectionReport& get_report() const {
+            return report;
+        }
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+
+
+// building blocks for a simulation that gives the same bits on every compiler, platform and language - only
+// integer arithmetic, with every rounding spelled out so the Java, Python and Rust clients can match it
+
+
+// Q16.16 fixed point, so 1.0 is 65536 - products are rounded towards negative infinity and quotients towards
+// zero, both through 64 bits so neither overflows inside the court
+class Fixed {
+    private:
+        int32_t raw = 0;
+
+    public:
+        static constexpr int FRACTION_BITS = 16;
+        static constexpr int32_t ONE = 1 << FRACTION_BITS;
+
+        constexpr Fixed() = default;
+
+        static constexpr Fixed from_raw(int32_t value) {
+            Fixed fixed;
+            fixed.raw = value;
+            return fixed;
+        }
+
+        // rounds to the nearest step, exact for anything the simulation wrote out itself - meant for constants
+        // and for values that came from to_float, never for arithmetic
+        static constexpr Fixed from_float(float value) {
+            return from_raw(static_cast<int32_t>(value * ONE + (value < 0.0f ? -0.5f : 0.5f)));
+        }
+
+        // exact while the magnitude stays below 256, which covers everything on the court
+        explicit constexpr operator float() const { return static_cast<float>(raw) / ONE; }
+
+        constexpr int32_t get_raw() const { return raw; }
+
+        constexpr Fixed operator-() const { return from_raw(-raw); }
+        constexpr Fixed operator+(Fixed other) const { return from_raw(raw + other.raw); }
+        constexpr Fixed operator-(Fixed other) const { return from_raw(raw - other.raw); }
+        constexpr Fixed operator*(Fixed other) const { return from_raw(static_cast<int32_t>((static_cast<int64_t>(raw) * other.raw) >> FRACTION_BITS)); }
+        constexpr Fixed operator/(Fixed other) const { return from_raw(static_cast<int32_t>(static_cast<int64_t>(raw) * ONE / other.raw)); }
+        constexpr Fixed operator*(int32_t factor) const { return from_raw(raw * factor); }
+
+        constexpr Fixed& operator+=(Fixed other) { return *this = *this + other; }
+        constexpr Fixed& operator-=(Fixed other) { return *this = *this - other; }
+        constexpr Fixed& operator*=(Fixed other) { return *this = *this * other; }
+
+        constexpr bool operator==(Fixed other) const { return raw == other.raw; }
+        constexpr bool operator!=(Fixed other) const { return raw != other.raw; }
+        constexpr bool operator<(Fixed other) const { return raw < other.raw; }
+        constexpr bool operator>(Fixed other) const { return raw > other.raw; }
+        constexpr bool operator<=(Fixed other) const { return raw <= other.raw; }
+        constexpr bool operator>=(Fixed other) const { return raw >= other.raw; }
+};
+
+constexpr Fixed abs(Fixed value) {
+    return value < Fixed() ? -value : value;
+}
+
+
+// PCG32 (XSH-RR) on a fixed stream - small, fast and simple to port, and the whole generator is one integer
+// that can go into a checksum
+class Random {
+    private:
+        static constexpr uint64_t MULTIPLIER = 6364136223846793005ULL;
+        static constexpr uint64_t INCREMENT = 1442695040888963407ULL;
+
+        uint64_t state = 0;
+
+    public:
+        explicit Random(uint64_t seed = 0) {
+            next();
+            state += seed;
+            next();
+        }
+
+        uint32_t next() {
+            uint64_t previous = state;
+            state = previous * MULTIPLIER + INCREMENT;
+            uint32_t xorshifted = static_cast<uint32_t>(((previous >> 18) ^ previous) >> 27);
+            uint32_t rotation = static_cast<uint32_t>(previous >> 59);
+            return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+        }
+
+        bool coin() { return next() >> 31; }
+
+        uint64_t get_state() const { return state; }
+};
+
+
+// 32-bit FNV-1a over little-endian words, cheap enough to take every tick
+class Checksum {
+    private:
+        uint32_t hash = 2166136261u;
+
+    public:
+        Checksum& add(uint32_t value) {
+            for (int i = 0; i < 4; i++) {
+                hash = (hash ^ ((value >> (i * 8)) & 0xff)) * 16777619u;
+            }
+            return *this;
+        }
+
+        Checksum& add(int32_t value) { return add(static_cast<uint32_t>(value)); }
+        Checksum& add(Fixed value) { return add(value.get_raw()); }
+        Checksum& add(uint64_t value) { return add(static_cast<uint32_t>(value)).add(static_cast<uint32_t>(value >> 32)); }
+
+        uint32_t get() const { return hash; }
+};
@@ -0,0 +1,287 @@
+#include "logger.h"
+
+#include <mutex>
+#include <vector>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+static constexpr size_t BATCH_SIZE = 64 * 1024;  // bytes formatted before they are written out
+static constexpr auto IDLE_WAIT = std::chrono::milliseconds(1);
+
+std::mutex Logger::rings_mutex;
+std::vector<Logger::Ring*> Logger::rings;
+std::thread Logger::writer;
+std::atomic<bool> Logger::stopping{ false };
+std::mutex Logger::output_mutex;
+
+static std::once_flag shutdown_registered;
+static std::mutex sites_mutex;
+
+Logger::RingOwner::~RingOwner() {
+    if (ring) ring->retired.store(true, std::memory_order_release);
+}
+
+Logger::Ring* Logger::register_ring() {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+
+    if (stopping.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+
+    Ring* ring = new Ring();
+    rings.push_back(ring);
+    thread_ring.ring = ring;
+
+    if (!writer.joinable()) {
+        accepting.store(true, std::memory_order_relaxed);
+        writer = std::thread(&Logger::writer_loop);
+        std::call_once(shutdown_registered, [] { std::atexit(&Logger::shutdown); });
+    }
+
+    return ring;
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        stopping.store(true, std::memory_order_release);
+        accepting.store(false, std::memory_order_relaxed);
+    }
+
+    if (writer.joinable() && writer.get_id() != std::this_thread::get_id()) {
+        writer.join();
+    }
+
+    if (binary.is_open()) {
+        binary.close();
+
+        if (uint64_t lost = binary_dropped.exchange(0, std::memory_order_relaxed)) {
+            log(Level::Warning, "Logger dropped ", lost, " binary records because the log file was full");
+        }
+    }
+}
+
+bool Logger::open_binary(const std::string& path, size_t capacity) {
+    if (!binary.open(path, capacity)) {
+        return false;
+    }
+
+    std::call_once(shutdown_registered, [] { std::atexit(&Logger::shutdown); });
+    return true;
+}
+
+// threads reaching a new call site together both build its descriptor, but only the first one writes it
+uint32_t Logger::publish_site(std::atomic<uint32_t>& site, Level message_level, const char* payload, size_t size) {
+    std::lock_guard<std::mutex> lock(sites_mutex);
+
+    if (uint32_t id = site.load(std::memory_order_acquire)) {
+        return id;
+    }
+
+    uint32_t id = next_site.fetch_add(1, std::memory_order_relaxed);
+    binary_log::EntryHeader header{ static_cast<uint16_t>(sizeof(header) + size), binary_log::Kind::Site, static_cast<uint8_t>(message_level), id, now() };
+
+    // when the file is already full the records of this site will not fit either
+    if (char* destination = binary.reserve(header.size)) {
+        std::memcpy(destination, &header, sizeof(header));
+        std::memcpy(destination + sizeof(header), payload, size);
+    }
+
+    site.store(id, std::memory_order_release);
+    return id;
+}
+
+void Logger::write_now(const Record& record) {
+    std::string output;
+    format(record, output);
+
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    std::fflush(stdout);
+}
+
+// sleeps only when a pass found nothing, so a busy process is drained continuously
+void Logger::writer_loop() {
+    std::string batch;
+    batch.reserve(BATCH_SIZE * 2);
+    std::vector<Ring*> snapshot;
+
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (!drain(batch, snapshot)) {
+            std::this_thread::sleep_for(IDLE_WAIT);
+        }
+    }
+
+    drain(batch, snapshot);
+}
+
+static void write_batch(std::string& batch, std::mutex& output_mutex) {
+    if (batch.empty()) return;
+
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::fwrite(batch.data(), 1, batch.size(), stdout);
+    std::fflush(stdout);
+    batch.clear();
+}
+
+// each pass takes the oldest record at the front of any ring, so lines from different threads come out in
+// the order they were logged as long as the rings are drained faster than they fill
+//
+// the lock is only held to copy the list of rings and to free retired ones, so a thread logging for the first
+// time never waits on the console - only the writer frees rings, so the copied pointers stay valid, and a ring
+// registered meanwhile is picked up on the next pass
+bool Logger::drain(std::string& batch, std::vector<Ring*>& snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        snapshot.assign(rings.begin(), rings.end());
+    }
+
+    size_t written = 0;
+
+    while (true) {
+        Ring* oldest_ring = nullptr;
+        Record* oldest = nullptr;
+
+        for (Ring* ring : snapshot) {
+            Record* record = ring->records.front();
+
+            if (record && (!oldest || record->timestamp < oldest->timestamp)) {
+                oldest = record;
+                oldest_ring = ring;
+            }
+        }
+
+        if (!oldest) break;
+
+        format(*oldest, batch);
+        oldest_ring->records.pop_front();
+        written++;
+
+        if (batch.size() >= BATCH_SIZE) {
+            write_batch(batch, output_mutex);
+        }
+    }
+
+    if (uint64_t lost = dropped.exchange(0, std::memory_order_relaxed)) {
+        Record record;
+        capture(record, Level::Warning, "Logger dropped ", lost, " records because the writer fell behind");
+        format(record, batch);
+    }
+
+    write_batch(batch, output_mutex);
+
+    // rings of threads that have exited are freed once everything they logged has been written
+    std::lock_guard<std::mutex> lock(rings_mutex);
+
+    for (auto it = rings.begin(); it != rings.end();) {
+        Ring* ring = *it;
+
+        if (ring->retired.load(std::memory_order_acquire) && ring->records.empty()) {
+            delete ring;
+            it = rings.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    return written > 0;
+}
+
+static const char* level_string(Logger::Level level) {
+    switch (level) {
+        case Logger::Level::Debug: return "DEBUG";
+        case Logger::Level::Info: return "INFO";
+        case Logger::Level::Warning: return "WARNING";
+        case Logger::Level::Error: return "ERROR";
+        default: return "OTHER";
+    }
+}
+
+// the date and time only change once a second, so they are formatted once and reused
+static void append_timestamp(int64_t timestamp, std::string& output) {
+    thread_local time_t cached_second = -1;
+    thread_local char cached[32];
+
+    time_t second = static_cast<time_t>(timestamp / 1000000000);
+
+    if (second != cached_second) {
+        struct tm tm_info;
+#ifdef _WIN32
+        localtime_s(&tm_info, &second);
+#else
+        localtime_r(&second, &tm_info);
+#endif
+        std::strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tm_info);
+        cached_second = second;
+    }
+
+    int milliseconds = static_cast<int>(timestamp / 1000000 % 1000);
+    const char fraction[4] = { ',', static_cast<char>('0' + milliseconds / 100), static_cast<char>('0' + milliseconds / 10 % 10), static_cast<char>('0' + milliseconds % 10) };
+
+    output += cached;
+    output.append(fraction, sizeof(fraction));
+}
+
+void Logger::format(const Record& record, std::string& output) {
+    output += '[';
+    append_timestamp(record.timestamp, output);
+    output += "] ";
+    output += level_string(record.level);
+    output += ": ";
+
+    char number[32];
+    size_t offset = 0;
+
+    while (offset < record.size) {
+        Tag tag = static_cast<Tag>(record.payload[offset++]);
+        const char* data = record.payload + offset;
+
+        switch (tag) {
+            case Tag::Signed: {
+                int64_t value;
+                std::memcpy(&value, data, sizeof(value));
+                output.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+                offset += sizeof(value);
+                break;
+            }
+            case Tag::Unsigned: {
+                uint64_t value;
+                std::memcpy(&value, data, sizeof(value));
+                output.append(number, std::to_chars(number, number + sizeof(number), value).ptr);
+                offset += sizeof(value);
+                break;
+            }
+            case Tag::Float: {
+                double value;
+                std::memcpy(&value, data, sizeof(value));
+                output.append(number, static_cast<size_t>(std::snprintf(number, sizeof(number), "%g", value)));
+                offset += sizeof(value);
+                break;
+            }
+            case Tag::Bool:
+                output += *data ? '1' : '0';
+                offset += sizeof(bool);
+                break;
+            case Tag::Char:
+                output += *data;
+                offset += sizeof(char);
+                break;
+            case Tag::Text:
+            case Tag::Literal: {
+                uint16_t length;
+                std::memcpy(&length, data, sizeof(length));
+                output.append(data + sizeof(length), length);
+                offset += sizeof(length) + length;
+                break;
+            }
+        }
+    }
+
+    if (record.truncated) {
+        output += "...";
+    }
+
+    output += '\n';
+}
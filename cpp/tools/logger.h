@@ -1,18 +1,30 @@
 #pragma once
 
-#include <iostream>
-#include <iomanip>
+#include "spsc_queue.h"
+#include "binary_log.h"
+
+#include <atomic>
 #include <chrono>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
 
-#ifdef _WIN32
-#define LOCALTIME(resultptr, timeptr) localtime_s((resultptr), (timeptr))
-#else
-#define LOCALTIME(resultptr, timeptr) std::localtime_r((timeptr), (resultptr))
+// the lowest level compiled in at all - the build raises it for release builds, which removes every debug
+// record from the binary along with the code that builds its arguments
+#ifndef MULTI_PONG_LOG_LEVEL
+#define MULTI_PONG_LOG_LEVEL 0
 #endif
 
-
+// records are captured on the calling thread into its own ring without formatting or locking, and a
+// background writer merges every thread's ring by timestamp, formats the records and writes them in batches
 class Logger {
     public:
         enum class Level : uint8_t {
@@ -21,65 +33,328 @@ class Logger {
             Warning = 2,
             Error   = 3
         };
-        
+
+        // what a thread does when its ring is full because the writer has fallen behind
+        enum class Overflow : uint8_t {
+            Drop,  // count the record and move on, the writer reports how many were lost
+            Block  // wait for the writer to make room
+        };
+
     private:
-        static std::string get_timestamp() {
-            auto now = std::chrono::system_clock::now();
-            auto tt = std::chrono::system_clock::to_time_t(now);
-            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-            
-            struct tm tm_info;
-#ifdef _WIN32
-            localtime_s(&tm_info, &tt);
-#else
-            localtime_r(&tt, &tm_info);
-#endif
- 
-            std::stringstream ss;
-            ss << std::put_time(&tm_info, "%Y-%m-%d %H:%M:%S");
-            ss << "," << std::setfill('0') << std::setw(3) << ms.count();
-            return ss.str();
-        }
-        
-        static std::string get_level_string(Level level) {
-            switch (level) {
-                case Level::Debug: return "DEBUG";
-                case Level::Info: return "INFO";
-                case Level::Warning: return "WARNING";
-                case Level::Error: return "ERROR";
-                default: return "OTHER";
+        static constexpr size_t RECORD_SIZE = 512;  // longer lines are cut short
+        static constexpr size_t RING_CAPACITY = 1024;  // records per thread, half a megabyte
+
+        using Tag = binary_log::Argument;
+
+        struct Record {
+            int64_t timestamp;  // system clock, nanoseconds since the epoch
+            Level level;
+            bool truncated;
+            uint16_t size;
+            char payload[RECORD_SIZE - 12];
+        };
+
+        struct Ring {
+            SpscQueue<Record, RING_CAPACITY> records;
+            std::atomic<bool> retired{ false };  // the owning thread has exited
+        };
+
+        // hands the ring over to the writer when its thread exits, the writer frees it once drained - only
+        // ever thread_local, so the pointer starts out zero-initialised
+        struct RingOwner {
+            Ring* ring;
+            ~RingOwner();
+        };
+
+        inline static thread_local RingOwner thread_ring;
+        inline static std::atomic<bool> accepting{ false };  // the writer is running and draining rings
+        inline static std::atomic<uint64_t> dropped{ 0 };
+
+        static std::mutex rings_mutex;  // guards the list of rings, never held while formatting or writing
+        static std::vector<Ring*> rings;
+        static std::thread writer;
+        static std::atomic<bool> stopping;
+        static std::mutex output_mutex;
+
+        static Ring* register_ring();
+        static void write_now(const Record& record);
+        static void writer_loop();
+        static bool drain(std::string& batch, std::vector<Ring*>& snapshot);
+        static void format(const Record& record, std::string& output);
+
+        // appends to a fixed buffer - text is cut short to fit, anything else that does not fit is left out
+        struct Writer {
+            char* data;
+            size_t capacity;
+            size_t size = 0;
+            bool truncated = false;
+
+            bool put(const void* bytes, size_t length) {
+                if (truncated || size + length > capacity) {
+                    truncated = true;
+                    return false;
+                }
+
+                std::memcpy(data + size, bytes, length);
+                size += length;
+                return true;
+            }
+
+            bool put_text(std::string_view text) {
+                if (truncated || size + sizeof(uint16_t) > capacity) {
+                    truncated = true;
+                    return false;
+                }
+
+                uint16_t length = static_cast<uint16_t>(std::min(text.size(), capacity - size - sizeof(uint16_t)));
+                std::memcpy(data + size, &length, sizeof(length));
+                std::memcpy(data + size + sizeof(length), text.data(), length);
+                size += sizeof(length) + length;
+                truncated = length < text.size();
+                return true;
+            }
+        };
+
+        // Arg is the type as passed to the call, so string literals can be told apart from char buffers
+        template<typename Arg>
+        static constexpr Tag argument_of() {
+            using Value = std::decay_t<Arg>;
+            using Unreferenced = std::remove_reference_t<Arg>;
+
+            if constexpr (std::is_array_v<Unreferenced> && std::is_same_v<std::remove_extent_t<Unreferenced>, const char>) {
+                return Tag::Literal;
+            } else if constexpr (std::is_same_v<Value, bool>) {
+                return Tag::Bool;
+            } else if constexpr (std::is_same_v<Value, char>) {
+                return Tag::Char;
+            } else if constexpr (std::is_enum_v<Value> || (std::is_integral_v<Value> && std::is_signed_v<Value>)) {
+                return Tag::Signed;
+            } else if constexpr (std::is_integral_v<Value>) {
+                return Tag::Unsigned;
+            } else if constexpr (std::is_floating_point_v<Value>) {
+                return Tag::Float;
+            } else {
+                return Tag::Text;
+            }
+        }
+
+        // numbers and strings are stored as they are, anything else is streamed to text on the calling thread
+        template<typename Arg, typename T>
+        static bool put_value(Writer& writer, const T& value) {
+            constexpr Tag tag = argument_of<Arg>();
+
+            if constexpr (tag == Tag::Bool || tag == Tag::Char) {
+                return writer.put(&value, 1);
+            } else if constexpr (tag == Tag::Signed) {
+                int64_t number = static_cast<int64_t>(value);
+                return writer.put(&number, sizeof(number));
+            } else if constexpr (tag == Tag::Unsigned) {
+                uint64_t number = static_cast<uint64_t>(value);
+                return writer.put(&number, sizeof(number));
+            } else if constexpr (tag == Tag::Float) {
+                double number = static_cast<double>(value);
+                return writer.put(&number, sizeof(number));
+            } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                return writer.put_text(std::string_view(value));
+            } else {
+                std::ostringstream stream;
+                stream << value;
+                return writer.put_text(stream.str());
             }
         }
 
+        // text records carry every argument behind its tag, literals included
+        template<typename Arg, typename T>
+        static void encode(Writer& writer, const T& value) {
+            constexpr Tag tag = argument_of<Arg>() == Tag::Literal ? Tag::Text : argument_of<Arg>();
+            size_t start = writer.size;
+
+            if (!writer.put(&tag, sizeof(tag)) || !put_value<Arg>(writer, value)) {
+                writer.size = start;
+            }
+        }
+
+        static int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
         template<typename... Args>
-        static void log(Level message_level, Args&&... args) {
-            if (message_level >= level) {
-                std::cout << "[" << get_timestamp() << "] " << get_level_string(message_level) << ": ";
-                ((std::cout << args), ...);
-                std::cout << std::endl;
+        static void capture(Record& record, Level message_level, Args&&... args) {
+            Writer writer{ record.payload, sizeof(record.payload) };
+            (encode<Args>(writer, args), ...);
+
+            record.timestamp = now();
+            record.level = message_level;
+            record.truncated = writer.truncated;
+            record.size = static_cast<uint16_t>(writer.size);
+        }
+
+        // binary records leave the literals to the site descriptor, which is written once per call site
+        inline static BinaryLog binary;
+        inline static std::atomic<uint32_t> next_site{ 1 };
+        inline static std::atomic<uint64_t> binary_dropped{ 0 };
+
+        static uint32_t publish_site(std::atomic<uint32_t>& site, Level message_level, const char* payload, size_t size);
+
+        template<typename Arg, typename T>
+        static void describe(Writer& writer, const T& value) {
+            constexpr Tag tag = argument_of<Arg>();
+            writer.put(&tag, sizeof(tag));
+
+            if constexpr (tag == Tag::Literal) {
+                writer.put_text(value);
+            }
+        }
+
+        template<typename Arg, typename T>
+        static void store(Writer& writer, const T& value) {
+            if constexpr (argument_of<Arg>() != Tag::Literal) {
+                put_value<Arg>(writer, value);
+            }
+        }
+
+        template<typename... Args>
+        static uint32_t register_site(std::atomic<uint32_t>& site, Level message_level, const char* file, int line, Args&&... args) {
+            char payload[binary_log::MAX_ENTRY - sizeof(binary_log::EntryHeader)];
+            Writer writer{ payload, sizeof(payload) };
+
+            uint32_t line_number = static_cast<uint32_t>(line);
+            uint8_t count = static_cast<uint8_t>(sizeof...(Args));
+            writer.put_text(file);
+            writer.put(&line_number, sizeof(line_number));
+            writer.put(&count, sizeof(count));
+
+            (describe<Args>(writer, args), ...);
+
+            return publish_site(site, message_level, payload, writer.size);
+        }
+
+        template<typename... Args>
+        static void write_binary(uint32_t site, Level message_level, Args&&... args) {
+            thread_local char entry[binary_log::MAX_ENTRY];
+            Writer writer{ entry + sizeof(binary_log::EntryHeader), sizeof(entry) - sizeof(binary_log::EntryHeader) };
+
+            (store<Args>(writer, args), ...);
+
+            binary_log::EntryHeader header{ static_cast<uint16_t>(sizeof(header) + writer.size), binary_log::Kind::Record, static_cast<uint8_t>(message_level), site, now() };
+            std::memcpy(entry, &header, sizeof(header));
+
+            char* destination = binary.reserve(header.size);
+            if (!destination) {
+                binary_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
             }
+
+            std::memcpy(destination, entry, header.size);
         }
 
     public:
+        template<typename... Args>
+        static void log(Level message_level, Args&&... args) {
+            if (message_level < level) {
+                return;
+            }
+
+            Ring* ring = thread_ring.ring;
+
+            if (!ring && asynchronous) {
+                ring = register_ring();
+            }
+
+            // before the writer starts and after it has shut down records are written on the calling thread
+            if (!ring || !asynchronous || !accepting.load(std::memory_order_relaxed)) {
+                Record record;
+                capture(record, message_level, std::forward<Args>(args)...);
+                write_now(record);
+                return;
+            }
+
+            Record* record = ring->records.reserve();
+
+            while (!record) {
+                if (overflow == Overflow::Drop || !accepting.load(std::memory_order_relaxed)) {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+
+                std::this_thread::yield();
+                record = ring->records.reserve();
+            }
+
+            capture(*record, message_level, std::forward<Args>(args)...);
+            ring->records.commit();
+        }
+
+        // the same as log, but into the binary log when one is open - site belongs to the call site and holds
+        // its descriptor id once the descriptor has been written
+        template<typename... Args>
+        static void log_site(std::atomic<uint32_t>& site, Level message_level, const char* file, int line, Args&&... args) {
+            if (!binary.is_open()) {
+                log(message_level, std::forward<Args>(args)...);
+                return;
+            }
+
+            uint32_t id = site.load(std::memory_order_acquire);
+
+            if (id == 0) {
+                id = register_site(site, message_level, file, line, args...);
+            }
+
+            write_binary(id, message_level, args...);
+        }
+
+        // every record that goes through the macros is written to path from here on, until shutdown
+        static bool open_binary(const std::string& path, size_t capacity = binary_log::DEFAULT_CAPACITY);
+
         inline static Level level = Logger::Level::Info;
-        
+        inline static Overflow overflow = Logger::Overflow::Drop;
+        inline static bool asynchronous = true;  // set before the first record to write everything synchronously
+
+        static constexpr Level compiled_level = static_cast<Level>(MULTI_PONG_LOG_LEVEL);
+
+        static constexpr bool compiled(Level message_level) {
+            return message_level >= compiled_level;
+        }
+
+        static bool enabled(Level message_level) {
+            return message_level >= level;
+        }
+
+        // writes out everything captured so far and stops the writer, later records are written synchronously -
+        // registered with atexit when the writer starts
+        static void shutdown();
+
         template<typename... Args>
         static void debug(Args&&... args) {
             log(Level::Debug, std::forward<Args>(args)...);
         }
-        
+
         template<typename... Args>
         static void info(Args&&... args) {
             log(Level::Info, std::forward<Args>(args)...);
         }
-        
+
         template<typename... Args>
         static void warning(Args&&... args) {
             log(Level::Warning, std::forward<Args>(args)...);
         }
-        
+
         template<typename... Args>
         static void error(Args&&... args) {
             log(Level::Error, std::forward<Args>(args)...);
         }
 };
+
+// unlike calling Logger directly, the arguments are only evaluated once the level is known to be enabled
+#define LOGGER_LOG(message_level, ...) \
+    do { \
+        if constexpr (Logger::compiled(message_level)) { \
+            static std::atomic<uint32_t> logger_site{ 0 }; \
+            if (Logger::enabled(message_level)) Logger::log_site(logger_site, message_level, __FILE__, __LINE__, __VA_ARGS__); \
+        } \
+    } while (false)
+
+#define LOGGER_DEBUG(...) LOGGER_LOG(Logger::Level::Debug, __VA_ARGS__)
+#define LOGGER_INFO(...) LOGGER_LOG(Logger::Level::Info, __VA_ARGS__)
+#define LOGGER_WARNING(...) LOGGER_LOG(Logger::Level::Warning, __VA_ARGS__)
+#define LOGGER_ERROR(...) LOGGER_LOG(Logger::Level::Error, __VA_ARGS__)
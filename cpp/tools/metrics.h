@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+// log-linear histogram in the style of HdrHistogram - every power of two is split into SUB_BUCKETS
+// linear buckets, so recording is a handful of bit operations and the relative error stays under
+// 1 / SUB_BUCKETS across the whole 64-bit range
+class Histogram {
+    private:
+        static constexpr int SUB_BUCKET_BITS = 4;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static constexpr int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        std::array<uint64_t, BUCKETS> counts{};
+        uint64_t total = 0;
+        uint64_t sum = 0;
+        uint64_t minimum = std::numeric_limits<uint64_t>::max();
+        uint64_t maximum = 0;
+
+        static int highest_bit(uint64_t value) {
+#ifdef _MSC_VER
+            unsigned long bit;
+            _BitScanReverse64(&bit, value);
+            return static_cast<int>(bit);
+#else
+            return 63 - __builtin_clzll(value);
+#endif
+        }
+
+        // values below SUB_BUCKETS are exact, above that the bucket is picked by the highest set bit
+        // and the SUB_BUCKET_BITS bits below it
+        static int bucket_index(uint64_t value) {
+            if (value < SUB_BUCKETS) {
+                return static_cast<int>(value);
+            }
+
+            int shift = highest_bit(value) - SUB_BUCKET_BITS;
+            return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+        }
+
+        // largest value that lands in a bucket
+        static uint64_t bucket_value(int index) {
+            int region = index / SUB_BUCKETS;
+            uint64_t sub_bucket = static_cast<uint64_t>(index % SUB_BUCKETS);
+
+            if (region == 0) {
+                return sub_bucket;
+            }
+            return ((SUB_BUCKETS + sub_bucket + 1) << (region - 1)) - 1;
+        }
+
+    public:
+        void record(uint64_t value) {
+            counts[bucket_index(value)]++;
+            total++;
+            sum += value;
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+
+        uint64_t count() const { return total; }
+        uint64_t min() const { return total ? minimum : 0; }
+        uint64_t max() const { return maximum; }
+        uint64_t mean() const { return total ? sum / total : 0; }
+
+        uint64_t percentile(double percentile) const {
+            if (!total) {
+                return 0;
+            }
+
+            uint64_t target = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total) + 0.5);
+            target = std::clamp<uint64_t>(target, 1, total);
+
+            uint64_t seen = 0;
+            for (int i = 0; i < BUCKETS; i++) {
+                seen += counts[i];
+                if (seen >= target) {
+                    return std::min(bucket_value(i), maximum);
+                }
+            }
+            return maximum;
+        }
+
+        void merge(const Histogram& other) {
+            for (int i = 0; i < BUCKETS; i++) {
+                counts[i] += other.counts[i];
+            }
+            total += other.total;
+            sum += other.sum;
+            minimum = std::min(minimum, other.minimum);
+            maximum = std::max(maximum, other.maximum);
+        }
+
+        void reset() {
+            *this = Histogram();
+        }
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "logger.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+// command line handling shared by the client, server and coordinator executables
+
+inline std::optional<std::pair<std::string, int>> parse_address(const std::string& address) {
+    auto colon = address.find(':');
+    if (colon == std::string::npos) return std::nullopt;
+
+    std::string host = address.substr(0, colon);
+    int port = 0;
+
+    try {
+        port = std::stoi(address.substr(colon + 1));
+        if (port < 1 || port > 65535) return std::nullopt;
+    }
+    catch (...) {
+        return std::nullopt;
+    }
+
+    return std::make_pair(host, port);
+}
+
+// accepts host:port or host:first-last for a contiguous range of ports
+inline std::optional<std::vector<std::pair<std::string, int>>> parse_address_range(const std::string& address) {
+    auto colon = address.find(':');
+    auto dash = address.find('-', colon == std::string::npos ? 0 : colon);
+
+    if (colon == std::string::npos || dash == std::string::npos) {
+        if (auto single = parse_address(address)) return std::vector<std::pair<std::string, int>>{ *single };
+        return std::nullopt;
+    }
+
+    auto first = parse_address(address.substr(0, dash));
+    auto last = parse_address(address.substr(0, colon + 1) + address.substr(dash + 1));
+    if (!first || !last || last->second < first->second) return std::nullopt;
+
+    std::vector<std::pair<std::string, int>> addresses;
+    for (int port = first->second; port <= last->second; port++) {
+        addresses.emplace_back(first->first, port);
+    }
+    return addresses;
+}
+
+inline std::optional<int> parse_port(const std::string& value) {
+    try {
+        int port = std::stoi(value);
+        if (port >= 1 && port <= 65535) return port;
+    } catch (...) {}
+
+    return std::nullopt;
+}
+
+inline std::optional<uint64_t> parse_unsigned(const std::string& value) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) return std::nullopt;
+
+    try {
+        return std::stoull(value);
+    } catch (...) {}
+
+    return std::nullopt;
+}
+
+struct LogOptions {
+    Logger::Level level = Logger::Level::Info;
+    Logger::Overflow overflow = Logger::Overflow::Drop;
+    std::optional<std::string> binary_log;
+};
+
+enum class OptionResult {
+    Unknown,  // not a logging option
+    Parsed,
+    Invalid  // a logging option with a missing or bad value, already reported
+};
+
+// consumes argv[i] and its value when it is one of the logging options
+inline OptionResult parse_log_option(int argc, char** argv, int& i, LogOptions& options) {
+    std::string argument = argv[i];
+
+    if (argument == "--verbose") {
+        options.level = Logger::Level::Debug;
+    } else if (argument == "--log-overflow") {
+        std::string policy = i + 1 < argc ? argv[++i] : "";
+        if (policy == "drop") {
+            options.overflow = Logger::Overflow::Drop;
+        } else if (policy == "block") {
+            options.overflow = Logger::Overflow::Block;
+        } else {
+            LOGGER_ERROR("Specify what to do when the log falls behind with --log-overflow <drop|block>");
+            return OptionResult::Invalid;
+        }
+    } else if (argument == "--binary-log") {
+        if (i + 1 < argc) {
+            options.binary_log = argv[++i];
+        } else {
+            LOGGER_ERROR("Specify the file to write binary log records to with --binary-log <path>");
+            return OptionResult::Invalid;
+        }
+    } else {
+        return OptionResult::Unknown;
+    }
+
+    return OptionResult::Parsed;
+}
+
+inline constexpr const char* LOG_OPTIONS_HELP =
+    "  --verbose                     enable debug logging\n"
+    "  --log-overflow <drop|block>   drop log records or wait when the writer falls behind <drop>\n"
+    "  --binary-log <path>           write log records to a file in binary, read with log_decoder\n";
+
+// false when the binary log could not be opened
+inline bool apply_log_options(const LogOptions& options) {
+    Logger::level = options.level;
+    Logger::overflow = options.overflow;
+
+    if (options.level == Logger::Level::Debug && !Logger::compiled(Logger::Level::Debug)) {
+        LOGGER_WARNING("Debug logging was compiled out of this build - --verbose only shows info and above");
+    }
+
+    if (options.binary_log) {
+        LOGGER_INFO("Writing log records to ", *options.binary_log);
+
+        if (!Logger::open_binary(*options.binary_log)) {
+            LOGGER_ERROR("Failed to open binary log ", *options.binary_log);
+            return false;
+        }
+    }
+
+    return true;
+}
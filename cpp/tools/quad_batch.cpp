@@ -0,0 +1,217 @@
+#include "quad_batch.h"
+#include "logger.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstdint>
+
+static const char* VERTEX_SHADER = R"(
+#version 330 core
+
+layout (location = 0) in vec2 corner;
+layout (location = 1) in vec4 quad;  // centre x, centre y, width, height
+
+uniform mat4 projection;
+
+void main() {
+    gl_Position = projection * vec4(quad.xy + corner * quad.zw, 0.0, 1.0);
+}
+)";
+
+static const char* FRAGMENT_SHADER = R"(
+#version 330 core
+
+out vec4 FragColour;
+
+void main() {
+    FragColour = vec4(1.0, 1.0, 1.0, 1.0);
+}
+)";
+
+static GLuint compile_shader(GLenum type, const char* source) {
+    LOGGER_DEBUG("Compiling shader type ", type);
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success) {
+        char log[512];
+        glGetShaderInfoLog(shader, 512, nullptr, log);
+        LOGGER_ERROR("Shader compilation error: ", log);
+        return 0;
+    }
+
+    return shader;
+}
+
+static GLuint create_shader_program(const char* vertex_shader_source, const char* fragment_shader_source) {
+    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+
+    if (!vertex_shader || !fragment_shader) return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(program, 512, nullptr, log);
+        LOGGER_ERROR("Shader linking error: ", log);
+        return 0;
+    }
+
+    LOGGER_DEBUG("Created shader program successfully");
+    return program;
+}
+
+bool QuadBatch::setup() {
+    shader = create_shader_program(VERTEX_SHADER, FRAGMENT_SHADER);
+    if (!shader) return false;
+
+    set_projection(0.0f, 1.0f, 1.0f, 0.0f);
+
+    const float corners[8] = {
+        -0.5f, -0.5f,
+         0.5f, -0.5f,
+        -0.5f,  0.5f,
+         0.5f,  0.5f
+    };
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &corner_buffer);
+    glGenBuffers(1, &instance_buffer);
+
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, corner_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    GLsizeiptr ring_size = static_cast<GLsizeiptr>(REGIONS * capacity * FLOATS_PER_QUAD * sizeof(float));
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+    // buffer storage is core in 4.4, older contexts upload each region from a staging copy instead
+    if (GLAD_GL_VERSION_4_4) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, ring_size, nullptr, flags);
+        mapped = static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, ring_size, flags));
+        persistent = mapped != nullptr;
+    }
+
+    if (!persistent) {
+        glBufferData(GL_ARRAY_BUFFER, ring_size, nullptr, GL_STREAM_DRAW);
+        staging.resize(capacity * FLOATS_PER_QUAD);
+    }
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    LOGGER_DEBUG("Quad batch holds ", capacity, " quads per draw using ", persistent ? "a persistently mapped" : "a staged", " ring buffer");
+    return true;
+}
+
+void QuadBatch::set_projection(float left, float right, float bottom, float top) {
+    glm::mat4 projection = glm::ortho(left, right, bottom, top, -1.0f, 1.0f);
+    glUseProgram(shader);
+    glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+}
+
+float* QuadBatch::region_data() {
+    return persistent ? mapped + region * capacity * FLOATS_PER_QUAD : staging.data();
+}
+
+// waits for the GPU to finish with the region's previous contents, normally long done three draws later
+void QuadBatch::acquire_region() {
+    GLsync& fence = fences[region];
+
+    if (fence) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    region_acquired = true;
+}
+
+void QuadBatch::add(float x, float y, float width, float height) {
+    if (!vao) return;
+
+    if (count == capacity) {
+        draw();
+    }
+
+    if (!region_acquired) {
+        acquire_region();
+    }
+
+    float* quad = region_data() + count * FLOATS_PER_QUAD;
+    quad[0] = x;
+    quad[1] = y;
+    quad[2] = width;
+    quad[3] = height;
+    count++;
+}
+
+void QuadBatch::draw() {
+    if (!count) return;
+
+    size_t region_offset = region * capacity * FLOATS_PER_QUAD * sizeof(float);
+
+    glUseProgram(shader);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+
+    if (!persistent) {
+        glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(region_offset), static_cast<GLsizeiptr>(count * FLOATS_PER_QUAD * sizeof(float)), staging.data());
+    }
+
+    // pointing the instance attribute at the region avoids needing base instance support
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_QUAD * sizeof(float), (void*)static_cast<uintptr_t>(region_offset));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % REGIONS;
+    region_acquired = false;
+    count = 0;
+}
+
+void QuadBatch::release() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = nullptr;
+    }
+
+    if (shader) glDeleteProgram(shader);
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (corner_buffer) glDeleteBuffers(1, &corner_buffer);
+    if (instance_buffer) glDeleteBuffers(1, &instance_buffer);
+
+    shader = vao = corner_buffer = instance_buffer = 0;
+    count = 0;
+}
+
+QuadBatch::~QuadBatch() {
+    release();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.h"
+
+#include <glad/glad.h>
+
+#include <array>
+#include <vector>
+#include <cstddef>
+
+// draws any number of axis-aligned quads with one instanced draw call - a static unit quad is stretched by
+// a per-instance centre and size that is streamed through a ring of buffer regions, each region fenced
+// after its draw so the CPU never overwrites instances the GPU has not consumed yet
+class QuadBatch {
+	private:
+		static constexpr size_t REGIONS = 3;
+		static constexpr size_t FLOATS_PER_QUAD = 4;
+
+		size_t capacity;  // quads per region
+		GLuint shader = 0, vao = 0, corner_buffer = 0, instance_buffer = 0;
+		bool persistent = false;
+		float* mapped = nullptr;  // the whole ring when persistently mapped
+		std::vector<float> staging;  // a single region when buffer storage is unavailable
+		std::array<GLsync, REGIONS> fences{};
+		size_t region = 0;
+		size_t count = 0;
+		bool region_acquired = false;
+
+		float* region_data();
+		void acquire_region();
+
+	public:
+		explicit QuadBatch(size_t quads_per_draw = MULTI_PONG_QUAD_BATCH_CAPACITY) : capacity(quads_per_draw) {}
+		~QuadBatch();
+
+		QuadBatch(const QuadBatch&) = delete;
+		QuadBatch& operator=(const QuadBatch&) = delete;
+
+		bool setup();
+		void set_projection(float left, float right, float bottom, float top);
+		void add(float x, float y, float width, float height);
+		void draw();
+		void release();  // frees the GL objects, must run while the context is still current
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "common.h"
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+
+// ordered, acknowledged delivery for the few control messages that must not be lost, over the same socket
+// as everything else - those messages carry a sequence number and the cumulative acknowledgement of the
+// peer's, so a reply acknowledges what it answers, and whatever goes unacknowledged for a retransmission
+// timeout is sent again with the timeout doubled
+//
+// the timeout follows RFC 6298 and is only measured from messages that were never resent, and each side
+// picks a random session so that a restarted peer starts its sequence over instead of being taken for a
+// run of duplicates
+class ReliableChannel {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        enum class Receipt {
+            Unreliable,  // carries no sequence, handled as it always was
+            Delivered,  // the messages handed back are next in order
+            Held  // a duplicate, an acknowledgement or ahead of a gap - nothing to handle yet
+        };
+
+    private:
+        static constexpr size_t MAX_EARLY = 64;  // messages kept while an earlier one is missing
+
+        struct Outgoing {
+            uint32_t sequence;
+            multi_pong::Message message;
+            clock::time_point sent_at;
+            clock::time_point due;
+            uint32_t attempts;
+        };
+
+        uint32_t session;
+        uint32_t next_sequence = 1;
+        std::deque<Outgoing> unacknowledged;
+
+        uint32_t peer_session = 0;
+        uint32_t delivered = 0;  // every sequence of the peer's up to this one has been handed over
+        std::map<uint32_t, multi_pong::Message> early;
+        bool acknowledgement_owed = false;
+        clock::time_point last_activity{};
+
+        std::chrono::microseconds smoothed_rtt{ 0 };
+        std::chrono::microseconds rtt_variance{ 0 };
+        std::chrono::microseconds timeout = std::chrono::milliseconds(MULTI_PONG_RELIABLE_INITIAL_TIMEOUT);
+
+        static uint32_t random_session() {
+            static thread_local std::mt19937 rng(std::random_device{}());
+            return std::uniform_int_distribution<uint32_t>(1, UINT32_MAX)(rng);
+        }
+
+        void measure(std::chrono::microseconds rtt) {
+            using namespace std::chrono;
+
+            if (smoothed_rtt.count() == 0) {
+                smoothed_rtt = rtt;
+                rtt_variance = rtt / 2;
+            } else {
+                rtt_variance = (rtt_variance * 3 + abs(smoothed_rtt - rtt)) / 4;
+                smoothed_rtt = (smoothed_rtt * 7 + rtt) / 8;
+            }
+
+            timeout = smoothed_rtt + std::max<microseconds>(milliseconds(MULTI_PONG_TIMER_RESOLUTION), rtt_variance * 4);
+            timeout = std::clamp<microseconds>(timeout, milliseconds(MULTI_PONG_RELIABLE_MIN_TIMEOUT), milliseconds(MULTI_PONG_RELIABLE_MAX_TIMEOUT));
+        }
+
+        void acknowledge(uint32_t sequence, clock::time_point now) {
+            while (!unacknowledged.empty() && unacknowledged.front().sequence <= sequence) {
+                const Outgoing& outgoing = unacknowledged.front();
+
+                if (outgoing.attempts == 1) {
+                    measure(std::chrono::duration_cast<std::chrono::microseconds>(now - outgoing.sent_at));
+                }
+                unacknowledged.pop_front();
+            }
+        }
+
+        // the header is refreshed on every send, so a resent message carries the newest acknowledgement
+        void stamp(multi_pong::Message& message) {
+            multi_pong::Reliable* header = message.mutable_reliable();
+            header->set_session(session);
+
+            if (header->has_sequence()) {
+                header->set_oldest(unacknowledged.empty() ? header->sequence() : std::min(unacknowledged.front().sequence, header->sequence()));
+            }
+
+            if (peer_session != 0) {
+                header->set_acknowledged(delivered);
+                header->set_acknowledged_session(peer_session);
+                acknowledgement_owed = false;
+            }
+        }
+
+    public:
+        ReliableChannel() : session(random_session()) {}
+
+        // sequences the message and keeps a copy until the peer acknowledges it, the caller sends it as usual
+        void send(multi_pong::Message& message, clock::time_point now) {
+            message.mutable_reliable()->set_sequence(next_sequence++);
+            stamp(message);
+            unacknowledged.push_back({ message.reliable().sequence(), message, now, now + timeout, 1 });
+            last_activity = now;
+        }
+
+        Receipt receive(const multi_pong::Message& message, clock::time_point now, std::vector<multi_pong::Message>& ready) {
+            if (!message.has_reliable()) {
+                return Receipt::Unreliable;
+            }
+
+            const multi_pong::Reliable& header = message.reliable();
+            last_activity = now;
+
+            if (header.has_acknowledged() && header.acknowledged_session() == session) {
+                acknowledge(header.acknowledged(), now);
+            }
+
+            if (!header.has_sequence()) {
+                return Receipt::Held;
+            }
+
+            // whatever the peer sent before its oldest unacknowledged message went to an earlier incarnation of us
+            if (header.session() != peer_session) {
+                peer_session = header.session();
+                delivered = (header.has_oldest() ? header.oldest() : header.sequence()) - 1;
+                early.clear();
+            }
+
+            acknowledgement_owed = true;
+            uint32_t sequence = header.sequence();
+
+            if (sequence <= delivered) {
+                return Receipt::Held;
+            }
+
+            if (sequence != delivered + 1) {
+                if (early.size() < MAX_EARLY) {
+                    early.emplace(sequence, message);
+                }
+                return Receipt::Held;
+            }
+
+            ready.push_back(message);
+            delivered = sequence;
+
+            for (auto it = early.begin(); it != early.end() && it->first == delivered + 1; it = early.erase(it)) {
+                ready.push_back(std::move(it->second));
+                delivered++;
+            }
+            return Receipt::Delivered;
+        }
+
+        // resends whatever has timed out and acknowledges anything received that no reply has carried back
+        // yet - false once a message has gone unacknowledged too often, everything unacknowledged is dropped then
+        template<typename Transmit>
+        bool flush(clock::time_point now, Transmit&& transmit) {
+            bool resent = false;
+
+            for (const Outgoing& outgoing : unacknowledged) {
+                if (outgoing.due <= now && outgoing.attempts >= MULTI_PONG_RELIABLE_ATTEMPTS) {
+                    // a new session lets the peer pick up from whatever is sent next instead of waiting on these
+                    unacknowledged.clear();
+                    session = random_session();
+                    next_sequence = 1;
+                    timeout = std::chrono::milliseconds(MULTI_PONG_RELIABLE_INITIAL_TIMEOUT);
+                    return false;
+                }
+            }
+
+            for (Outgoing& outgoing : unacknowledged) {
+                if (outgoing.due > now) {
+                    continue;
+                }
+
+                if (!resent) {
+                    timeout = std::min<std::chrono::microseconds>(timeout * 2, std::chrono::milliseconds(MULTI_PONG_RELIABLE_MAX_TIMEOUT));
+                    resent = true;
+                }
+
+                stamp(outgoing.message);
+                transmit(outgoing.message);
+                outgoing.due = now + timeout;
+                outgoing.attempts++;
+            }
+
+            if (acknowledgement_owed) {
+                multi_pong::Message acknowledgement;
+                stamp(acknowledgement);
+                transmit(acknowledgement);
+            }
+            return true;
+        }
+
+        // nothing left to send, and quiet for longer than the peer could still be resending - forgetting the
+        // channel then cannot hand a retransmitted message over a second time
+        bool is_idle(clock::time_point now) const {
+            constexpr auto LINGER = std::chrono::milliseconds(MULTI_PONG_RELIABLE_MAX_TIMEOUT) * MULTI_PONG_RELIABLE_ATTEMPTS;
+            return unacknowledged.empty() && !acknowledgement_owed && now - last_activity >= LINGER;
+        }
+};
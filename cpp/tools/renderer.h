@@ -2,12 +2,23 @@
 
 class Client;
 
+struct FramePacing {
+	enum class Mode {
+		VSync,  // present once per display refresh
+		Capped,  // present at a fixed rate without waiting for the display
+		OnDemand  // only redraw when a new state or input arrives
+	};
+
+	Mode mode = Mode::VSync;
+	int fps = 60;  // frame rate used by Capped
+};
+
 class Renderer {
 	public:
 		virtual ~Renderer() = default;
 
 		virtual bool setup(Client* c) = 0;
 		virtual void toggle_fullscreen() = 0;
-		virtual void update_state() = 0;
+		virtual void update_state() = 0;  // called from the network thread whenever a new state is received
 		virtual void render_loop() = 0;
 };
@@ -87,7 +87,7 @@ LRESULT DirectX11Renderer::HandleMessage(HWND hwnd, UINT message, WPARAM wParam,
 
 
 bool DirectX11Renderer::setup(Client* c) {
-    Logger::debug("Initialising DirectX11-based renderer...");
+    LOGGER_DEBUG("Initialising DirectX11-based renderer...");
 
     client = c;
 
@@ -116,7 +116,7 @@ bool DirectX11Renderer::setup(Client* c) {
     );
 
     if (!window) {
-        Logger::error("Failed to create window: ", GetLastError());
+        LOGGER_ERROR("Failed to create window: ", GetLastError());
         return false;
     }
 
@@ -130,7 +130,7 @@ bool DirectX11Renderer::setup(Client* c) {
 }
 
 bool DirectX11Renderer::initialise_device() {
-    Logger::debug("Creating device and swap chain...");
+    LOGGER_DEBUG("Creating device and swap chain...");
 
     DXGI_SWAP_CHAIN_DESC swap_chain_description = { 0 };
     swap_chain_description.BufferDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -157,7 +157,7 @@ bool DirectX11Renderer::initialise_device() {
         &device_context);
 
     if (FAILED(result)) {
-        Logger::error("Failed to create the device and swap chain");
+        LOGGER_ERROR("Failed to create the device and swap chain");
         return false;
     }
     
@@ -165,7 +165,7 @@ bool DirectX11Renderer::initialise_device() {
     result = swap_chain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)&back_buffer);
 
     if (FAILED(result)) {
-        Logger::error("Failed to get back buffer");
+        LOGGER_ERROR("Failed to get back buffer");
         return false;
     }
 
@@ -173,11 +173,11 @@ bool DirectX11Renderer::initialise_device() {
     back_buffer->Release();
 
     if (FAILED(result)) {
-        Logger::error("Failed to create render target view");
+        LOGGER_ERROR("Failed to create render target view");
         return false;
     }
 
-    Logger::debug("Created device / swap chain / render target view");
+    LOGGER_DEBUG("Created device / swap chain / render target view");
     return true;
 }
 
@@ -202,7 +202,7 @@ ID3DBlob* DirectX11Renderer::compile_shader(const char* shader_source, LPCSTR en
     if (FAILED(result)) {
         if (error_blob) {
             const char* error = static_cast<const char*>(error_blob->GetBufferPointer());
-            Logger::error("Shader compilation error: ", error);
+            LOGGER_ERROR("Shader compilation error: ", error);
             error_blob->Release();
         }
         if (shader_blob) shader_blob->Release();
@@ -212,7 +212,7 @@ ID3DBlob* DirectX11Renderer::compile_shader(const char* shader_source, LPCSTR en
 }
 
 bool DirectX11Renderer::compile_shaders() {
-    Logger::debug("Compiling shaders...");
+    LOGGER_DEBUG("Compiling shaders...");
 
     vertex_shader_blob = compile_shader(VERTEX_SHADER, "vs_main", "vs_5_0");
     pixel_shader_blob = compile_shader(PIXEL_SHADER, "ps_main", "ps_5_0");
@@ -221,7 +221,7 @@ bool DirectX11Renderer::compile_shaders() {
 
     device->CreateVertexShader(vertex_shader_blob->GetBufferPointer(), vertex_shader_blob->GetBufferSize(), nullptr, &vertex_shader);
     device->CreatePixelShader(pixel_shader_blob->GetBufferPointer(), pixel_shader_blob->GetBufferSize(), nullptr, &pixel_shader);
-    Logger::debug("Compiled shaders succesfully");
+    LOGGER_DEBUG("Compiled shaders succesfully");
     return true;
 }
 
@@ -249,7 +249,7 @@ void DirectX11Renderer::generate_buffers() {
     viewport.Height = static_cast<float>(rectangle.bottom - rectangle.top);
     device_context->RSSetViewports(1, &viewport);
 
-    Logger::debug("Created vertex buffers successfully");
+    LOGGER_DEBUG("Created vertex buffers successfully");
 }
 
 void DirectX11Renderer::toggle_fullscreen() {
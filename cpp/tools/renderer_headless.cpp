@@ -0,0 +1,160 @@
+#include "renderer_headless.h"
+#include "logger.h"
+#include "../client.h"
+
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+bool HeadlessRenderer::setup(Client* c) {
+    LOGGER_DEBUG("Initialising headless renderer...");
+
+    client = c;
+
+    if (input.source == HeadlessInput::Source::Script) {
+        return load_script();
+    }
+    return true;
+}
+
+bool HeadlessRenderer::load_script() {
+    std::ifstream file(input.script_path);
+    if (!file) {
+        LOGGER_ERROR("Failed to open input script ", input.script_path);
+        return false;
+    }
+
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream fields(line);
+        uint64_t frame;
+        std::string direction;
+
+        if (!(fields >> frame)) continue;
+
+        if (!(fields >> direction)) {
+            LOGGER_WARNING("Missing direction on line ", line_number, " of ", input.script_path);
+            continue;
+        }
+
+        if (direction == "up") {
+            script.push_back({ frame, multi_pong::Direction::UP });
+        } else if (direction == "down") {
+            script.push_back({ frame, multi_pong::Direction::DOWN });
+        } else if (direction == "stop") {
+            script.push_back({ frame, multi_pong::Direction::STOP });
+        } else {
+            LOGGER_WARNING("Unknown direction '", direction, "' on line ", line_number, " of ", input.script_path);
+        }
+    }
+
+    std::stable_sort(script.begin(), script.end(), [](const ScriptedMove& a, const ScriptedMove& b) {
+        return a.frame < b.frame;
+    });
+
+    LOGGER_INFO("Loaded ", script.size(), " scripted moves from ", input.script_path);
+    return true;
+}
+
+void HeadlessRenderer::apply_input(const multi_pong::State& state, uint64_t match_frame) {
+    if (input.source == HeadlessInput::Source::Script) {
+        while (next_move < script.size() && script[next_move].frame <= match_frame) {
+            client->send_move(script[next_move++].direction);
+        }
+        return;
+    }
+
+    if (input.source != HeadlessInput::Source::Bot) {
+        return;
+    }
+
+    auto identifier = client->get_identifier();
+    if (!identifier) return;
+
+    const multi_pong::Player& own_player = *identifier == multi_pong::Player::PLAYER_1 ? state.player_1() : state.player_2();
+    float offset = state.ball().y() - own_player.paddle_location();
+
+    // a dead zone around the paddle centre stops the bot from jittering on every frame
+    multi_pong::Direction direction = multi_pong::Direction::STOP;
+    if (offset < -MULTI_PONG_PADDLE_HEIGHT / 4.0f) {
+        direction = multi_pong::Direction::UP;
+    } else if (offset > MULTI_PONG_PADDLE_HEIGHT / 4.0f) {
+        direction = multi_pong::Direction::DOWN;
+    }
+
+    if (direction != bot_direction) {
+        bot_direction = direction;
+        client->send_move(direction);
+    }
+}
+
+void HeadlessRenderer::render_loop() {
+    using clock = std::chrono::steady_clock;
+
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / std::max(pacing.fps, 1)));
+    auto next_frame = clock::now();
+    auto next_report = next_frame + std::chrono::seconds(1);
+
+    Histogram sample_times;  // microseconds spent sampling the state each frame
+    uint64_t frame = 0;
+    uint64_t match_start = 0;
+    uint64_t report_frames = 0;
+    uint64_t repeated_frames = 0;
+    uint64_t skipped_server_frames = 0;
+    uint32_t last_server_frame = 0;
+
+    while (!input.frames || frame < input.frames) {
+        next_frame += period;
+        if (next_frame < clock::now()) {
+            next_frame = clock::now();
+        }
+        std::this_thread::sleep_until(next_frame);
+
+        auto sample_start = clock::now();
+        const multi_pong::State& state = client->get_state();
+        sample_times.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - sample_start).count()));
+
+        if (state.frame() != 0 && last_server_frame == 0) {
+            match_start = frame;
+        }
+
+        if (state.frame() == last_server_frame) {
+            repeated_frames += state.frame() != 0;
+        } else if (last_server_frame != 0 && state.frame() > last_server_frame) {
+            skipped_server_frames += state.frame() - last_server_frame - 1;
+        }
+        last_server_frame = state.frame();
+
+        if (state.frame() != 0) {
+            apply_input(state, frame - match_start);
+        }
+
+        LOGGER_DEBUG("Frame ", frame, " server frame ", state.frame(), " ball ", state.ball().x(), ",", state.ball().y(),
+            " paddles ", state.player_1().paddle_location(), ",", state.player_2().paddle_location());
+
+        frame++;
+        report_frames++;
+
+        if (clock::now() >= next_report) {
+            const ConnectionReport& connection = client->get_connection_report();
+            LOGGER_INFO("Headless ", report_frames, " fps, sampling mean ", sample_times.mean(), "us p99 ", sample_times.percentile(99), "us max ", sample_times.max(),
+                "us, server frame ", state.frame(), ", ", skipped_server_frames, " server frames skipped, ", repeated_frames, " frames without a new state, score ",
+                state.player_1().score(), "-", state.player_2().score(), ", rtt ", connection.rtt, "us jitter ", connection.jitter, "us");
+
+            sample_times.reset();
+            report_frames = 0;
+            repeated_frames = 0;
+            skipped_server_frames = 0;
+            next_report += std::chrono::seconds(1);
+        }
+    }
+
+    LOGGER_INFO("Headless client finished after ", frame, " frames");
+}
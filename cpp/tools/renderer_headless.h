@@ -0,0 +1,53 @@
+#pragma once
+
+#include "renderer.h"
+#include "metrics.h"
+
+#include <protobufs/pong.pb.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+class Client;
+
+struct HeadlessInput {
+	enum class Source {
+		None,
+		Script,  // directions read from a file of "<frame> <up|down|stop>" lines
+		Bot  // follows the ball with its own paddle
+	};
+
+	Source source = Source::None;
+	std::string script_path;
+	uint64_t frames = 0;  // stop after this many frames, zero runs until killed
+};
+
+// drives a client without a window or GPU - frames are sampled at the paced rate, input comes from a
+// script or a simple bot, and frame timing and state progress are logged for soak testing
+class HeadlessRenderer : public Renderer {
+	private:
+		struct ScriptedMove {
+			uint64_t frame;  // frames since the match started
+			multi_pong::Direction direction;
+		};
+
+		Client* client = nullptr;
+		FramePacing pacing;
+		HeadlessInput input;
+		std::vector<ScriptedMove> script;
+		size_t next_move = 0;
+		multi_pong::Direction bot_direction = multi_pong::Direction::STOP;
+
+		bool load_script();
+		void apply_input(const multi_pong::State& state, uint64_t match_frame);
+
+	public:
+		HeadlessRenderer(FramePacing frame_pacing = FramePacing(), HeadlessInput headless_input = HeadlessInput())
+			: pacing(frame_pacing), input(std::move(headless_input)) {}
+
+		bool setup(Client* c) override;
+		void toggle_fullscreen() override {};
+		void update_state() override {};
+		void render_loop() override;
+};
@@ -6,39 +6,18 @@
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 
-static const char* VERTEX_SHADER = R"(
-#version 330 core
-
-layout (location = 0) in vec2 position;
-
-uniform mat4 projection;
-
-void main() {
-    gl_Position = projection * vec4(position, 0.0, 1.0);
-}
-)";
-
-static const char* FRAGMENT_SHADER = R"(
-#version 330 core
-
-out vec4 FragColour;
-
-void main() {
-    FragColour = vec4(1.0, 1.0, 1.0, 1.0);
-}
-)";
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 bool OpenGLRenderer::setup(Client* c) {
-    Logger::debug("Initialising OpenGL-based renderer...");
+    LOGGER_DEBUG("Initialising OpenGL-based renderer...");
 
     client = c;
 
     if (!glfwInit()) {
-        Logger::error("Failed to initialise GLFW");
+        LOGGER_ERROR("Failed to initialise GLFW");
         return false;
     }
 
@@ -46,85 +25,25 @@ bool OpenGLRenderer::setup(Client* c) {
 
     if (!window) {
         glfwTerminate();
-        Logger::error("Failed to create GLFW window");
+        LOGGER_ERROR("Failed to create GLFW window");
         return false;
     }
 
     glfwMakeContextCurrent(window);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        Logger::error("Failed to initialise GLAD");
+        LOGGER_ERROR("Failed to initialise GLAD");
         return false;
     }
 
+    // capped and on-demand frames are paced by us, so the driver should not block on the display as well
+    glfwSwapInterval(pacing.mode == FramePacing::Mode::VSync ? 1 : 0);
+
     glClearColor(0.155f, 0.155f, 0.155f, 0.f);
     glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(window, keyboard_callback);
 
-    shader = create_shader_program(VERTEX_SHADER, FRAGMENT_SHADER);
-    generate_buffers();
-
-    return true;
-}
-
-GLuint OpenGLRenderer::compile_shader(GLenum type, const char* source) {
-    Logger::debug("Compiling shader type ", type);
-
-    GLuint shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
-
-    GLint success;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-
-    if (!success) {
-        char log[512];
-        glGetShaderInfoLog(shader, 512, nullptr, log);
-        Logger::error("Shader compilation error: ", log);
-        return 0;
-    }
-
-    return shader;
-}
-
-GLuint OpenGLRenderer::create_shader_program(const char* vertex_shader_source, const char* fragment_shader_source) {
-    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
-    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
-
-    if (!vertex_shader || !fragment_shader) return 0;
-
-    GLuint program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-
-    GLint success;
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-
-    if (!success) {
-        char log[512];
-        glGetProgramInfoLog(program, 512, nullptr, log);
-        Logger::error("Shader linking error: ", log);
-        return 0;
-    }
-
-    Logger::debug("Created shader program successfully");
-    return program;
-}
-
-void OpenGLRenderer::generate_buffers() {
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    return quads.setup();
 }
 
 void OpenGLRenderer::keyboard_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -153,6 +72,9 @@ void OpenGLRenderer::keyboard_callback(GLFWwindow* window, int key, int scancode
         case GLFW_KEY_F:
             renderer->toggle_fullscreen();
             break;
+        case GLFW_KEY_F3:
+            renderer->show_connection = !renderer->show_connection;
+            break;
         }
 }
 
@@ -165,54 +87,119 @@ void OpenGLRenderer::toggle_fullscreen() {
     }
 }
 
-// batching these draw calls would only provide a negligible performance boost
-void OpenGLRenderer::render_quad(float x, float y, float width, float height) {
-    float half_width = width / 2.0f;
-    float half_height = height / 2.0f;
+void OpenGLRenderer::update_state() {
+    if (pacing.mode == FramePacing::Mode::OnDemand) {
+        glfwPostEmptyEvent();
+    }
+}
 
-    float vertices[8] = {
-        x - half_width, y - half_height,
-        x + half_width, y - half_height,
-        x + half_width, y + half_height,
-        x - half_width, y + half_height
-    };
+// sleeping alone overshoots by up to a scheduler quantum, so the last stretch before the deadline is spun
+void OpenGLRenderer::wait_for_frame() {
+    using clock = std::chrono::steady_clock;
 
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    if (pacing.mode == FramePacing::Mode::VSync) {
+        glfwPollEvents();
+        return;
+    }
+
+    if (pacing.mode == FramePacing::Mode::OnDemand) {
+        glfwWaitEventsTimeout(MULTI_PONG_ON_DEMAND_TIMEOUT);
+        return;
+    }
+
+    auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / std::max(pacing.fps, 1)));
+    auto now = clock::now();
+
+    // after a stall start a fresh schedule instead of rendering a burst of frames to catch up
+    next_frame = now - next_frame > period ? now + period : next_frame + period;
+
+    auto spin_margin = std::chrono::microseconds(MULTI_PONG_FRAME_SPIN_MARGIN);
+    if (next_frame - now > spin_margin) {
+        std::this_thread::sleep_for(next_frame - now - spin_margin);
+    }
+
+    while (clock::now() < next_frame) {
+        std::this_thread::yield();
+    }
+
+    glfwPollEvents();
 }
 
 void OpenGLRenderer::render_window() {
     const multi_pong::State& state = client->get_state();
 
-    render_quad(state.ball().x(), state.ball().y(), MULTI_PONG_BALL_WIDTH, MULTI_PONG_BALL_HEIGHT);
+    quads.add(state.ball().x(), state.ball().y(), MULTI_PONG_BALL_WIDTH, MULTI_PONG_BALL_HEIGHT);
+
+    quads.add(MULTI_PONG_PADDLE_HORIZONTAL_PADDING, state.player_1().paddle_location(), MULTI_PONG_PADDLE_WIDTH, MULTI_PONG_PADDLE_HEIGHT);
+
+    quads.add(1.0f - MULTI_PONG_PADDLE_HORIZONTAL_PADDING, state.player_2().paddle_location(), MULTI_PONG_PADDLE_WIDTH, MULTI_PONG_PADDLE_HEIGHT);
+
+    if (show_connection) {
+        draw_connection_overlay();
+    }
+
+    quads.draw();
+}
+
+// a graph of recent round trips in the top left corner, scaled to the slowest one shown, with lines at the
+// smoothed round trip and one jitter above it - the two bars underneath are upstream and downstream loss
+void OpenGLRenderer::draw_connection_overlay() {
+    const ConnectionReport& report = client->get_connection_report();
+
+    constexpr float left = 0.02f, top = 0.03f, width = 0.2f, height = 0.08f;
+    constexpr float bar_width = width / MULTI_PONG_RTT_HISTORY;
+    constexpr float line = 0.002f;
+
+    uint32_t shown = std::min<uint32_t>(report.samples, MULTI_PONG_RTT_HISTORY);
+    uint32_t slowest = 1000;  // never scale below a millisecond
+
+    for (uint32_t i = 0; i < shown; i++) {
+        slowest = std::max(slowest, report.rtt_history[i]);
+    }
 
-    render_quad(MULTI_PONG_PADDLE_HORIZONTAL_PADDING, state.player_1().paddle_location(), MULTI_PONG_PADDLE_WIDTH, MULTI_PONG_PADDLE_HEIGHT);
+    float scale = height / static_cast<float>(slowest);
+    float bottom = top + height;
 
-    render_quad(1.0f - MULTI_PONG_PADDLE_HORIZONTAL_PADDING, state.player_2().paddle_location(), MULTI_PONG_PADDLE_WIDTH, MULTI_PONG_PADDLE_HEIGHT);
+    for (uint32_t i = 0; i < shown; i++) {
+        uint32_t rtt = report.rtt_history[(report.samples - shown + i) % MULTI_PONG_RTT_HISTORY];
+        float bar_height = std::max(static_cast<float>(rtt) * scale, line);
+        quads.add(left + (i + 0.5f) * bar_width, bottom - bar_height / 2.0f, bar_width * 0.6f, bar_height);
+    }
+
+    quads.add(left + width / 2.0f, bottom, width, line);
+
+    if (report.samples) {
+        quads.add(left + width / 2.0f, bottom - std::min(report.rtt * scale, height), width, line / 2.0f);
+        quads.add(left + width / 2.0f, bottom - std::min((report.rtt + report.jitter) * scale, height), width, line / 2.0f);
+    }
+
+    if (report.windows) {
+        const float losses[2] = { report.upstream_loss, report.downstream_loss };
+        for (int i = 0; i < 2; i++) {
+            float y = bottom + 0.01f + i * 0.008f;
+            quads.add(left + line / 2.0f, y, line, 0.006f);  // marks where the bar starts when nothing is lost
+            quads.add(left + losses[i] * width / 2.0f, y, losses[i] * width, 0.004f);
+        }
+    }
 }
 
 void OpenGLRenderer::render_loop() {
-    glm::mat4 projection = glm::ortho(0.0f, 1.0f, 1.0f, 0.0f, -1.0f, 1.0f);
-    
-    glUseProgram(shader);
-    glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glBindVertexArray(vao);
+    next_frame = std::chrono::steady_clock::now();
 
-    // not waiting for state updates
+    // events are handled and the state sampled only once the frame is due, right before drawing
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        wait_for_frame();
         glClear(GL_COLOR_BUFFER_BIT);
         render_window();
         glfwSwapBuffers(window);
     }
 
+    quads.release();
     glfwTerminate();
 }
 
 OpenGLRenderer::~OpenGLRenderer() {
-    if (shader) glDeleteProgram(shader);
-    if (vao) glDeleteVertexArrays(1, &vao);
-    if (vbo) glDeleteBuffers(1, &vbo);
+    quads.release();
     if (window) glfwDestroyWindow(window);
     glfwTerminate();
 }
\ No newline at end of file
@@ -1,32 +1,39 @@
 #pragma once
 
 #include "renderer.h"
+#include "quad_batch.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+
 class Client;
 
 class OpenGLRenderer : public Renderer {
 	private:
-		Client* client;
-		GLFWwindow* window;
-		GLuint shader = 0, vao = 0, vbo = 0;
-
-		void render_window();
-		void render_quad(float x, float y, float width, float height);
-		void generate_buffers();
-		
-		static GLuint compile_shader(GLenum type, const char* source);
-		static GLuint create_shader_program(const char* vertex_shader_source, const char* fragment_shader_source);
+		Client* client = nullptr;
+		std::chrono::steady_clock::time_point next_frame;
+		bool show_connection = false;  // toggled with F3
+
+		void wait_for_frame();
+		void draw_connection_overlay();
+
 		static void keyboard_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
+	protected:
+		GLFWwindow* window = nullptr;
+		QuadBatch quads;
+		FramePacing pacing;
+
+		virtual void render_window();
+
 	public:
-		OpenGLRenderer() {}
+		OpenGLRenderer(FramePacing frame_pacing = FramePacing()) : pacing(frame_pacing) {}
 		~OpenGLRenderer();
 
 		bool setup(Client* c) override;
 		void toggle_fullscreen() override;
-		void update_state() override {};
+		void update_state() override;
 		void render_loop() override;
 };
@@ -0,0 +1,57 @@
+#include "renderer_wall.h"
+#include "logger.h"
+#include "../spectator.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cmath>
+#include <algorithm>
+
+bool WallRenderer::setup(Spectator* s) {
+    LOGGER_DEBUG("Initialising spectator wall renderer...");
+
+    spectator = s;
+    return OpenGLRenderer::setup(nullptr);
+}
+
+void WallRenderer::render_window() {
+    size_t match_count = spectator->match_count();
+    if (!match_count) return;
+
+    size_t columns = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(match_count))));
+    size_t rows = (match_count + columns - 1) / columns;
+
+    float cell_width = 1.0f / columns;
+    float cell_height = 1.0f / rows;
+
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    // one pixel wide separators between the cells
+    float line_width = 1.0f / std::max(width, 1);
+    float line_height = 1.0f / std::max(height, 1);
+
+    for (size_t column = 1; column < columns; column++) {
+        quads.add(column * cell_width, 0.5f, line_width, 1.0f);
+    }
+
+    for (size_t row = 1; row < rows; row++) {
+        quads.add(0.5f, row * cell_height, 1.0f, line_height);
+    }
+
+    for (size_t i = 0; i < match_count; i++) {
+        const Snapshot* snapshot = spectator->get_snapshot(i);
+        if (!snapshot) continue;
+
+        float left = (i % columns) * cell_width;
+        float top = (i / columns) * cell_height;
+
+        quads.add(left + snapshot->ball_x * cell_width, top + snapshot->ball_y * cell_height, MULTI_PONG_BALL_WIDTH * cell_width, MULTI_PONG_BALL_HEIGHT * cell_height);
+
+        quads.add(left + MULTI_PONG_PADDLE_HORIZONTAL_PADDING * cell_width, top + snapshot->paddle_locations[0] * cell_height, MULTI_PONG_PADDLE_WIDTH * cell_width, MULTI_PONG_PADDLE_HEIGHT * cell_height);
+
+        quads.add(left + (1.0f - MULTI_PONG_PADDLE_HORIZONTAL_PADDING) * cell_width, top + snapshot->paddle_locations[1] * cell_height, MULTI_PONG_PADDLE_WIDTH * cell_width, MULTI_PONG_PADDLE_HEIGHT * cell_height);
+    }
+
+    quads.draw();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "renderer_opengl.h"
+
+class Spectator;
+
+// a grid of every spectated match in one window - each match is scaled into its own cell of the
+// normalised screen, so the whole wall still goes out through the quad batch in a single draw
+class WallRenderer : public OpenGLRenderer {
+	private:
+		Spectator* spectator = nullptr;
+
+	protected:
+		void render_window() override;
+
+	public:
+		WallRenderer(FramePacing frame_pacing = FramePacing()) : OpenGLRenderer(frame_pacing) {}
+
+		using OpenGLRenderer::setup;
+		bool setup(Spectator* s);
+};
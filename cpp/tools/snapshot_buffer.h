@@ -0,0 +1,132 @@
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+
+struct Snapshot {
+    uint32_t frame = 0;
+    int64_t received_at = 0;  // steady clock, microseconds
+    float ball_x = 0.5f;
+    float ball_y = 0.5f;
+    float paddle_locations[2] = { 0.5f, 0.5f };
+    uint32_t scores[2] = { 0, 0 };
+    uint32_t sequences[2] = { 0, 0 };  // last movement the server applied for each player
+    uint32_t sequence_frames[2] = { 0, 0 };
+};
+
+inline void read_snapshot(const multi_pong::State& state, int64_t received_at, Snapshot& snapshot) {
+    snapshot.frame = state.frame();
+    snapshot.received_at = received_at;
+    snapshot.ball_x = state.ball().x();
+    snapshot.ball_y = state.ball().y();
+    snapshot.paddle_locations[0] = state.player_1().paddle_location();
+    snapshot.paddle_locations[1] = state.player_2().paddle_location();
+    snapshot.scores[0] = state.player_1().score();
+    snapshot.scores[1] = state.player_2().score();
+    snapshot.sequences[0] = state.player_1().sequence();
+    snapshot.sequences[1] = state.player_2().sequence();
+    snapshot.sequence_frames[0] = state.player_1().sequence_frame();
+    snapshot.sequence_frames[1] = state.player_2().sequence_frame();
+}
+
+// time-indexed history of server snapshots, sampled a little in the past so that there is almost always
+// a snapshot on either side of the render time to interpolate between - server frames are mapped onto
+// the local clock through the earliest arrival seen, and the render delay follows the measured jitter
+class SnapshotBuffer {
+    private:
+        static constexpr size_t CAPACITY = 64;
+        static constexpr double TICK = MULTI_PONG_SERVER_UPDATE_RATE;  // microseconds per frame
+        static constexpr double MIN_DELAY = TICK;
+        static constexpr double MAX_DELAY = 250000.0;
+        static constexpr double JITTER_MULTIPLIER = 3.0;
+
+        std::array<Snapshot, CAPACITY> snapshots;
+        size_t count = 0;
+        size_t newest = 0;
+
+        bool synchronised = false;
+        double offset = 0.0;  // local time at which frame 0 would have arrived with no queuing
+        double last_transit = 0.0;
+        double jitter = 0.0;  // smoothed arrival deviation as in RFC 3550
+        double interval = TICK;  // smoothed time between the snapshots we receive
+        double delay = 2.0 * TICK;
+
+        const Snapshot& at(size_t age) const {
+            return snapshots[(newest + CAPACITY - age) % CAPACITY];
+        }
+
+    public:
+        void push(const Snapshot& snapshot) {
+            if (count && snapshot.frame <= at(0).frame) {
+                return;
+            }
+
+            double transit = static_cast<double>(snapshot.received_at) - snapshot.frame * TICK;
+
+            if (!synchronised) {
+                synchronised = true;
+                offset = transit;
+                last_transit = transit;
+            } else {
+                interval += (std::min<double>(snapshot.frame - at(0).frame, CAPACITY) * TICK - interval) / 16.0;
+                jitter += (std::abs(transit - last_transit) - jitter) / 16.0;
+                last_transit = transit;
+
+                // a faster arrival moves the mapping straight away, slower ones only creep it to follow clock drift
+                offset = transit < offset ? transit : offset + (transit - offset) / 1024.0;
+            }
+
+            double target = std::clamp(interval + JITTER_MULTIPLIER * jitter, MIN_DELAY, MAX_DELAY);
+            delay += (target - delay) / 32.0;
+
+            newest = (newest + 1) % CAPACITY;
+            snapshots[newest] = snapshot;
+            count = std::min(count + 1, CAPACITY);
+        }
+
+        bool empty() const { return count == 0; }
+        double render_delay() const { return delay; }
+        double arrival_jitter() const { return jitter; }
+
+        // the ball is not interpolated across a point being scored since it jumps back to the centre
+        Snapshot sample(int64_t now) const {
+            if (!count) {
+                return Snapshot();
+            }
+
+            double render_frame = (static_cast<double>(now) - delay - offset) / TICK;
+
+            if (render_frame >= at(0).frame) {
+                return at(0);
+            }
+
+            for (size_t age = 1; age < count; age++) {
+                const Snapshot& from = at(age);
+                const Snapshot& to = at(age - 1);
+
+                if (render_frame < from.frame) {
+                    continue;
+                }
+
+                float t = static_cast<float>((render_frame - from.frame) / static_cast<double>(to.frame - from.frame));
+
+                Snapshot result = from;
+                result.paddle_locations[0] = from.paddle_locations[0] + (to.paddle_locations[0] - from.paddle_locations[0]) * t;
+                result.paddle_locations[1] = from.paddle_locations[1] + (to.paddle_locations[1] - from.paddle_locations[1]) * t;
+
+                if (from.scores[0] == to.scores[0] && from.scores[1] == to.scores[1]) {
+                    result.ball_x = from.ball_x + (to.ball_x - from.ball_x) * t;
+                    result.ball_y = from.ball_y + (to.ball_y - from.ball_y) * t;
+                }
+                return result;
+            }
+
+            return at(count - 1);
+        }
+};
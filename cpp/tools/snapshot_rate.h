@@ -0,0 +1,108 @@
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+
+// per-player congestion control for the state stream in the style of TCP's AIMD - the rate grows by a
+// fixed step with every clean report from the client and halves when a report shows states being lost or
+// a queue building up, while a bandwidth ceiling caps it whatever the reports say
+//
+// states are sent on a credit that fills by the rate every tick, so a fractional rate spreads its states
+// evenly over the ticks instead of bunching them
+class SnapshotRate {
+    public:
+        static constexpr float MAX_RATE = 1000000.0f / MULTI_PONG_SERVER_UPDATE_RATE;  // one state every tick
+
+        enum class Verdict {
+            Unknown,  // the report could not be matched against what was sent
+            Increased,
+            Decreased
+        };
+
+    private:
+        static constexpr uint32_t HISTORY = 256;  // ticks of send counts kept to match reports against
+        static constexpr uint32_t LOSS_SAMPLES = 16;  // states a loss figure is worked out over at the least
+
+        float rate = MAX_RATE;  // states per second
+        float credit = 1.0f;
+        float ceiling = MAX_RATE;
+        uint32_t bandwidth = 0;  // bytes per second, zero for no ceiling
+
+        uint32_t states_sent = 0;
+        uint32_t newest_frame = 0;
+        std::array<uint32_t, HISTORY> sent_by_frame{};  // states sent up to and including each frame
+
+        uint32_t reported_frame = 0;
+        uint32_t reported_sent = 0;
+        uint32_t reported_received = 0;
+        uint32_t min_rtt = UINT32_MAX;
+
+        float loss = 0.0f;
+        uint32_t queueing = 0;  // microseconds
+
+    public:
+        void set_bandwidth(uint32_t bytes_per_second) { bandwidth = bytes_per_second; }
+
+        // called once per tick, state_bytes is the payload that would go out for this player
+        bool tick(uint32_t frame, size_t state_bytes) {
+            if (bandwidth) {
+                constexpr size_t UDP_OVERHEAD = 28;  // IPv4 and UDP headers
+                ceiling = std::clamp(static_cast<float>(bandwidth) / static_cast<float>(state_bytes + UDP_OVERHEAD), MULTI_PONG_SNAPSHOT_RATE_MIN, MAX_RATE);
+            }
+
+            credit = std::min(credit + std::min(rate, ceiling) / MAX_RATE, 1.0f);
+            bool send = credit >= 1.0f;
+
+            if (send) {
+                credit -= 1.0f;
+                states_sent++;
+            }
+
+            sent_by_frame[frame % HISTORY] = states_sent;
+            newest_frame = frame;
+            return send;
+        }
+
+        // a report names the newest state the client received and how many it has received in total, so
+        // the states sent since an earlier report against those received since then gives the loss - a
+        // report with too few states since is left to the next one rather than judged on chance
+        Verdict report(uint32_t received, uint32_t frame, uint32_t rtt) {
+            if (frame <= reported_frame || frame > newest_frame || newest_frame - frame >= HISTORY) {
+                return Verdict::Unknown;
+            }
+
+            min_rtt = std::min(min_rtt, rtt);
+            queueing = rtt - min_rtt;
+
+            uint32_t sent = sent_by_frame[frame % HISTORY];
+            uint32_t sent_since = sent - reported_sent;
+
+            if (sent_since < LOSS_SAMPLES && queueing <= MULTI_PONG_SNAPSHOT_QUEUE_LIMIT) {
+                return Verdict::Unknown;
+            }
+
+            uint32_t received_since = std::min(received - reported_received, sent_since);
+            loss = sent_since ? 1.0f - static_cast<float>(received_since) / static_cast<float>(sent_since) : 0.0f;
+
+            reported_frame = frame;
+            reported_sent = sent;
+            reported_received = received;
+
+            if (loss > MULTI_PONG_SNAPSHOT_LOSS_LIMIT || queueing > MULTI_PONG_SNAPSHOT_QUEUE_LIMIT) {
+                rate = std::max(std::min(rate, ceiling) * 0.5f, MULTI_PONG_SNAPSHOT_RATE_MIN);
+                return Verdict::Decreased;
+            }
+
+            rate = std::min(rate + MULTI_PONG_SNAPSHOT_RATE_STEP, MAX_RATE);
+            return Verdict::Increased;
+        }
+
+        float get_rate() const { return std::min(rate, ceiling); }
+        float get_loss() const { return loss; }
+        uint32_t get_queueing() const { return queueing; }
+};
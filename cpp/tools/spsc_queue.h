@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+
+// bounded single-producer single-consumer ring - each side only ever writes its own index, so pushing
+// and popping are wait-free and never allocate
+template<typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        std::array<T, Capacity> slots;
+        // each side's index shares a cache line only with that side's cached view of the other index
+        alignas(CACHE_LINE) std::atomic<size_t> head{ 0 };  // next slot to pop, written by the consumer
+        size_t cached_tail = 0;
+        alignas(CACHE_LINE) std::atomic<size_t> tail{ 0 };  // next slot to push, written by the producer
+        size_t cached_head = 0;
+
+    public:
+        bool push(T value) {
+            size_t current_tail = tail.load(std::memory_order_relaxed);
+
+            if (current_tail - cached_head == Capacity) {
+                cached_head = head.load(std::memory_order_acquire);
+                if (current_tail - cached_head == Capacity) {
+                    return false;
+                }
+            }
+
+            slots[current_tail & (Capacity - 1)] = std::move(value);
+            tail.store(current_tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        std::optional<T> pop() {
+            size_t current_head = head.load(std::memory_order_relaxed);
+
+            if (current_head == cached_tail) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (current_head == cached_tail) {
+                    return std::nullopt;
+                }
+            }
+
+            std::optional<T> value = std::move(slots[current_head & (Capacity - 1)]);
+            head.store(current_head + 1, std::memory_order_release);
+            return value;
+        }
+
+        // in-place variants for large elements - the producer fills the slot returned by reserve and then
+        // commits it, the consumer reads the slot returned by front and then releases it with pop_front
+        T* reserve() {
+            size_t current_tail = tail.load(std::memory_order_relaxed);
+
+            if (current_tail - cached_head == Capacity) {
+                cached_head = head.load(std::memory_order_acquire);
+                if (current_tail - cached_head == Capacity) {
+                    return nullptr;
+                }
+            }
+
+            return &slots[current_tail & (Capacity - 1)];
+        }
+
+        void commit() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        T* front() {
+            size_t current_head = head.load(std::memory_order_relaxed);
+
+            if (current_head == cached_tail) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (current_head == cached_tail) {
+                    return nullptr;
+                }
+            }
+
+            return &slots[current_head & (Capacity - 1)];
+        }
+
+        void pop_front() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+};
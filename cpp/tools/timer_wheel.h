@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+
+// hashed timing wheel - scheduling is O(1) and advancing only visits the slots that have elapsed,
+// timers further away than one revolution stay in their slot until their deadline comes around
+class TimerWheel {
+    public:
+        using clock = std::chrono::steady_clock;
+
+    private:
+        struct Timer {
+            uint64_t id;
+            clock::time_point deadline;
+        };
+
+        std::chrono::milliseconds resolution;
+        std::vector<std::vector<Timer>> slots;
+        clock::time_point current;
+        size_t cursor = 0;
+        size_t pending = 0;
+
+        // the first slot whose tick is at or past the deadline, never the slot that has already been visited
+        size_t slot_for(clock::time_point deadline) const {
+            auto ticks = deadline > current ? (deadline - current + resolution - clock::duration(1)) / resolution : 1;
+            return (cursor + static_cast<size_t>(std::max<decltype(ticks)>(ticks, 1))) % slots.size();
+        }
+
+    public:
+        TimerWheel(std::chrono::milliseconds tick_resolution, size_t slot_count)
+            : resolution(tick_resolution), slots(slot_count), current(clock::now()) {}
+
+        void schedule(uint64_t id, clock::time_point deadline) {
+            slots[slot_for(deadline)].push_back({ id, deadline });
+            pending++;
+        }
+
+        size_t size() const { return pending; }
+
+        template<typename F>
+        void advance(clock::time_point now, F&& on_expired) {
+            while (current + resolution <= now) {
+                current += resolution;
+                cursor = (cursor + 1) % slots.size();
+
+                std::vector<Timer>& slot = slots[cursor];
+                for (size_t i = 0; i < slot.size();) {
+                    if (slot[i].deadline > now) {
+                        i++;
+                        continue;
+                    }
+
+                    uint64_t id = slot[i].id;
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                    pending--;
+
+                    // the callback may schedule again, possibly into this same slot
+                    on_expired(id);
+                }
+            }
+        }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// timestamps of each input as it goes from the key press to the frame showing the server's answer - the
+// calls are compiled in only with MULTI_PONG_TRACE, which the latency benchmark builds with, so the game
+// itself carries none of them
+namespace trace {
+    enum class Stage : uint8_t {
+        KeyEvent,  // Client::send_move
+        MovementSent,  // the first Movement carrying the input left the client
+        ServerApplied,  // the server set the paddle direction from it
+        StateReceived,  // the client's network thread parsed the first state acknowledging it
+        FrameReady,  // the render thread finished the first frame built from that state
+        Count
+    };
+
+    inline constexpr size_t INPUTS = 4096;  // per player, older inputs are overwritten by sequence
+
+    struct Input {
+        std::atomic<int64_t> at[static_cast<size_t>(Stage::Count)];  // steady clock nanoseconds, zero until reached
+    };
+
+    inline Input inputs[2][INPUTS];
+
+    inline int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // only the first time an input reaches a stage counts, so resends and repeated acknowledgements do not
+    // move it - a key event starts the slot over
+    inline void mark(Stage stage, int player, uint32_t sequence) {
+        if (player < 0 || player > 1 || sequence == 0) return;
+
+        Input& input = inputs[player][sequence % INPUTS];
+
+        if (stage == Stage::KeyEvent) {
+            for (std::atomic<int64_t>& at : input.at) {
+                at.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        int64_t unset = 0;
+        input.at[static_cast<size_t>(stage)].compare_exchange_strong(unset, now(), std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    inline int64_t at(int player, uint32_t sequence, Stage stage) {
+        return inputs[player][sequence % INPUTS].at[static_cast<size_t>(stage)].load(std::memory_order_acquire);
+    }
+}
+
+#ifdef MULTI_PONG_TRACE
+#define TRACE_MARK(stage, player, sequence) trace::mark(trace::Stage::stage, static_cast<int>(player), sequence)
+#else
+#define TRACE_MARK(stage, player, sequence) do { } while (false)
+#endif
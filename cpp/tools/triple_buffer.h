@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+
+// wait-free handoff of the latest value from one writer thread to one reader thread - the writer fills
+// its back buffer and swaps it with the middle one, the reader swaps its front buffer with the middle
+// one only when something new has been published, so neither side ever sees a half written value
+template<typename T>
+class TripleBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "buffers are reused in place and must not own memory");
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+        static constexpr uint8_t INDEX = 0x3;
+        static constexpr uint8_t FRESH = 0x4;
+
+        std::array<T, 3> buffers{};
+        alignas(CACHE_LINE) std::atomic<uint8_t> middle{ 1 };  // index of the shared buffer and whether it is unread
+        alignas(CACHE_LINE) uint8_t back = 0;  // only touched by the writer
+        alignas(CACHE_LINE) uint8_t front = 2;  // only touched by the reader
+
+    public:
+        T& write_buffer() { return buffers[back]; }
+
+        void publish() {
+            back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // returns whether the front buffer was replaced by a newer value
+        bool update() {
+            if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+                return false;
+            }
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+
+        const T& read_buffer() const { return buffers[front]; }
+};
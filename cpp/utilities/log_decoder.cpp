@@ -0,0 +1,272 @@
+// renders a file written with --binary-log in the same format the text log uses, or one json object per
+// line with the call site and the raw argument values
+//
+// usage: log_decoder [--json] <path>
+
+#include "tools/binary_log.h"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+
+struct Site {
+    std::string file;
+    uint32_t line = 0;
+    std::vector<binary_log::Argument> arguments;
+    std::vector<std::string> literals;  // one per argument, only set for literals
+};
+
+// bounds-checked reads from an entry payload - a short read leaves the reader exhausted
+class Reader {
+    private:
+        const char* data;
+        size_t size;
+        size_t offset = 0;
+
+    public:
+        Reader(const char* data, size_t size) : data(data), size(size) {}
+
+        template<typename T>
+        bool read(T& value) {
+            if (offset + sizeof(T) > size) {
+                offset = size;
+                return false;
+            }
+
+            std::memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        bool read_text(std::string& text) {
+            uint16_t length;
+            if (!read(length) || offset + length > size) {
+                offset = size;
+                return false;
+            }
+
+            text.assign(data + offset, length);
+            offset += length;
+            return true;
+        }
+};
+
+static const char* level_string(uint8_t level) {
+    switch (level) {
+        case 0: return "DEBUG";
+        case 1: return "INFO";
+        case 2: return "WARNING";
+        case 3: return "ERROR";
+        default: return "OTHER";
+    }
+}
+
+static std::string timestamp_string(int64_t timestamp) {
+    time_t second = static_cast<time_t>(timestamp / 1000000000);
+    struct tm tm_info;
+#ifdef _WIN32
+    localtime_s(&tm_info, &second);
+#else
+    localtime_r(&second, &tm_info);
+#endif
+
+    char buffer[48];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_info);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ",%03d", static_cast<int>(timestamp / 1000000 % 1000));
+    return buffer;
+}
+
+static std::string json_string(std::string_view text) {
+    std::string output = "\"";
+
+    for (char character : text) {
+        switch (character) {
+            case '"': output += "\\\""; break;
+            case '\\': output += "\\\\"; break;
+            case '\n': output += "\\n"; break;
+            case '\r': output += "\\r"; break;
+            case '\t': output += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(character) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", character);
+                    output += escaped;
+                } else {
+                    output += character;
+                }
+        }
+    }
+
+    return output + "\"";
+}
+
+static bool parse_site(Reader& reader, Site& site) {
+    uint8_t count;
+    if (!reader.read_text(site.file) || !reader.read(site.line) || !reader.read(count)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        binary_log::Argument argument;
+        std::string literal;
+
+        if (!reader.read(argument) || (argument == binary_log::Argument::Literal && !reader.read_text(literal))) {
+            return false;
+        }
+
+        site.arguments.push_back(argument);
+        site.literals.push_back(std::move(literal));
+    }
+
+    return true;
+}
+
+// appends each argument to the message, and its value as json to values when it is not a literal
+static void render_record(Reader& reader, const Site& site, std::string& message, std::string& values) {
+    char number[32];
+
+    auto add = [&](const std::string& text, const std::string& json) {
+        message += text;
+        if (!values.empty()) values += ',';
+        values += json;
+    };
+
+    for (size_t i = 0; i < site.arguments.size(); i++) {
+        switch (site.arguments[i]) {
+            case binary_log::Argument::Literal:
+                message += site.literals[i];
+                continue;
+            case binary_log::Argument::Signed: {
+                int64_t value;
+                if (!reader.read(value)) return;
+                std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(value));
+                add(number, number);
+                break;
+            }
+            case binary_log::Argument::Unsigned: {
+                uint64_t value;
+                if (!reader.read(value)) return;
+                std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value));
+                add(number, number);
+                break;
+            }
+            case binary_log::Argument::Float: {
+                double value;
+                if (!reader.read(value)) return;
+                std::snprintf(number, sizeof(number), "%g", value);
+                std::string text = number;
+                add(text, text == "nan" || text == "inf" || text == "-inf" ? json_string(text) : text);
+                break;
+            }
+            case binary_log::Argument::Bool: {
+                char value;
+                if (!reader.read(value)) return;
+                add(value ? "1" : "0", value ? "true" : "false");
+                break;
+            }
+            case binary_log::Argument::Char: {
+                char value;
+                if (!reader.read(value)) return;
+                add(std::string(1, value), json_string(std::string_view(&value, 1)));
+                break;
+            }
+            case binary_log::Argument::Text: {
+                std::string value;
+                if (!reader.read_text(value)) return;
+                add(value, json_string(value));
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (!path) {
+        std::fprintf(stderr, "usage: %s [--json] <path>\n", argv[0]);
+        return -1;
+    }
+
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+
+    std::vector<char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    if (contents.size() < sizeof(binary_log::MAGIC) || std::memcmp(contents.data(), binary_log::MAGIC, sizeof(binary_log::MAGIC)) != 0) {
+        std::fprintf(stderr, "%s is not a binary log\n", path);
+        return -1;
+    }
+
+    std::unordered_map<uint32_t, Site> sites;
+    size_t offset = sizeof(binary_log::MAGIC);
+    uint64_t records = 0, unknown = 0;
+
+    // a zero size marks the end, whether the log was closed there or the process stopped mid-entry
+    while (offset + sizeof(binary_log::EntryHeader) <= contents.size()) {
+        binary_log::EntryHeader header;
+        std::memcpy(&header, contents.data() + offset, sizeof(header));
+
+        if (header.size < sizeof(header) || offset + header.size > contents.size()) {
+            break;
+        }
+
+        Reader reader(contents.data() + offset + sizeof(header), header.size - sizeof(header));
+        offset += header.size;
+
+        if (header.kind == binary_log::Kind::Site) {
+            Site site;
+            if (parse_site(reader, site)) {
+                sites[header.site] = std::move(site);
+            }
+            continue;
+        }
+
+        if (header.kind != binary_log::Kind::Record) {
+            continue;
+        }
+
+        auto it = sites.find(header.site);
+        if (it == sites.end()) {
+            unknown++;
+            continue;
+        }
+
+        std::string message, values;
+        render_record(reader, it->second, message, values);
+        records++;
+
+        if (json) {
+            std::printf("{\"timestamp\":%lld,\"level\":\"%s\",\"file\":%s,\"line\":%u,\"message\":%s,\"arguments\":[%s]}\n",
+                static_cast<long long>(header.timestamp), level_string(header.level), json_string(it->second.file).c_str(),
+                it->second.line, json_string(message).c_str(), values.c_str());
+        } else {
+            std::printf("[%s] %s: %s\n", timestamp_string(header.timestamp).c_str(), level_string(header.level), message.c_str());
+        }
+    }
+
+    std::fprintf(stderr, "%llu records from %zu call sites", static_cast<unsigned long long>(records), sites.size());
+    if (unknown) std::fprintf(stderr, ", %llu with no call site", static_cast<unsigned long long>(unknown));
+    std::fprintf(stderr, "\n");
+
+    return 0;
+}